@@ -1,31 +1,337 @@
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
 
 #include "bread.h"
+#include "candidate.h"
+#include "compgen.h"
 #include "config.h"
+#include "desktop_vec.h"
+#include "drun.h"
+#include "history.h"
+#include "input_file.h"
 #include "log.h"
+#include "reader.h"
+#include "result.h"
 #include "setup.h"
+#include "string_set.h"
+#include "string_vec.h"
+#include "surface.h"
+#include "xmalloc.h"
 
 void bread_apply_config(struct bread *bread, struct config *conf)
 {
-  return;
+  bread->num_results = conf->num_results;
 }
 
-struct bread bread_create(struct config *conf)
+/* Add the strings from first onwards to the candidates. */
+static void bread_add_strings(struct bread *bread, size_t first)
+{
+  for (size_t i = first; i < bread->strings.count; i++) {
+    candidate_vec_add(
+        &bread->candidates,
+        string_vec_get(&bread->strings, i),
+        bread->strings.entries[i].length);
+  }
+}
+
+/* A candidate to add, and what its history is kept under. */
+struct bread_entry {
+  const char *string;
+  size_t length;
+  const char *key;
+};
+
+/*
+ * Add entries to the candidates, weighted by how often and how recently
+ * each was chosen before, according to the history file called name.
+ *
+ * They're added highest weight first, so that they're already ranked for an
+ * empty query. Weights are small, so a counting sort puts them in order.
+ */
+static void bread_add_ranked(
+    struct bread *bread,
+    const struct bread_entry *entries,
+    size_t count,
+    const char *name)
+{
+  char *path = history_path(name);
+  if (path != NULL) {
+    history_open(&bread->history, path);
+    free(path);
+  }
+
+  const int64_t now = time(NULL);
+  int32_t *weights = xmalloc((count + 1) * sizeof(*weights));
+  size_t starts[HISTORY_WEIGHT_MAX + 2] = { 0 };
+  for (size_t i = 0; i < count; i++) {
+    weights[i] = history_weight(
+        &bread->history,
+        entries[i].key,
+        strlen(entries[i].key),
+        now);
+    starts[HISTORY_WEIGHT_MAX - weights[i] + 1]++;
+  }
+  for (size_t w = 1; w <= HISTORY_WEIGHT_MAX + 1; w++) {
+    starts[w] += starts[w - 1];
+  }
+  size_t *order = xmalloc((count + 1) * sizeof(*order));
+  for (size_t i = 0; i < count; i++) {
+    order[starts[HISTORY_WEIGHT_MAX - weights[i]]++] = i;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const struct bread_entry *entry = &entries[order[i]];
+    candidate_vec_add_weighted(
+        &bread->candidates,
+        entry->string,
+        entry->length,
+        weights[order[i]]);
+  }
+  free(order);
+  free(weights);
+}
+
+/*
+ * Load whatever candidates can be loaded up front. Candidates are otherwise
+ * piped in, in which case bread_run() reads them as they arrive, unless
+ * stdin is a terminal.
+ */
+static void bread_load_candidates(struct bread *bread, struct config *conf)
+{
+  bread->reader = (struct reader){ .fd = -1, .eof = true };
+  struct bread_entry *entries;
+  size_t count = 0;
+
+  switch (conf->mode) {
+    case MODE_RUN:
+      string_vec_destroy(&bread->strings);
+      bread->strings = compgen();
+      entries = xmalloc((bread->strings.count + 1) * sizeof(*entries));
+      for (size_t i = 0; i < bread->strings.count; i++) {
+        const char *command = string_vec_get(&bread->strings, i);
+        entries[count++] = (struct bread_entry){
+          .string = command,
+          .length = bread->strings.entries[i].length,
+          .key = command
+        };
+      }
+      bread_add_ranked(bread, entries, count, "run");
+      free(entries);
+      return;
+    case MODE_DRUN:
+      /* Applications are remembered by id, as their names are translated. */
+      bread->apps = drun_load();
+      entries = xmalloc((bread->apps.count + 1) * sizeof(*entries));
+      for (size_t i = 0; i < bread->apps.count; i++) {
+        const struct desktop_entry *app = &bread->apps.buf[i];
+        if (!app->no_display) {
+          const char *name = desktop_entry_name(app);
+          entries[count++] = (struct bread_entry){
+            .string = name,
+            .length = strlen(name),
+            .key = app->id
+          };
+        }
+      }
+      bread_add_ranked(bread, entries, count, "drun");
+      free(entries);
+      return;
+    case MODE_DMENU:
+      break;
+  }
+
+  if (conf->dedup) {
+    bread->seen = xmalloc(sizeof(*bread->seen));
+    *bread->seen = string_set_create();
+  }
+
+  if (conf->input_file != NULL) {
+    if (!input_file_open(&bread->input_file, conf->input_file)) {
+      exit(EXIT_FAILURE);
+    }
+    input_file_read(&bread->input_file, &bread->candidates, bread->seen);
+  } else if (!isatty(STDIN_FILENO)) {
+    bread->reader = reader_create(STDIN_FILENO);
+  }
+}
+
+/*
+ * Set up bread in place. Every Wayland listener is given bread as its data,
+ * and the results and the keyboard's input handler point into it, so it
+ * mustn't move once this is called.
+ */
+void bread_create(struct bread *bread, struct config *conf)
 {
   log_enter_context("bread_create");
 
-  struct bread bread = {
+  *bread = (struct bread){
     .name = "bread",
     .keyboard = keyboard_create(conf),
     .wayland = wayland_create(conf),
-    .window = window_create(conf)
+    .window = window_create(conf),
+    .strings = string_vec_create(),
+    .candidates = candidate_vec_create()
   };
 
-  bread_apply_config(&bread, conf);
+  bread_load_candidates(bread, conf);
+
+  bread_apply_config(bread, conf);
+
+  bread->results = results_create(
+      &bread->candidates,
+      MATCHING_ALGORITHM_FUZZY,
+      bread->num_results);
+  results_update(&bread->results, "");
+  bread->matched = bread->candidates.count;
+  bread->keyboard.input_handler.state = &bread->state;
+
+  setup_bread(bread);
+
+  log_leave_context();
+}
+
+void bread_destroy(struct bread *bread)
+{
+  results_destroy(&bread->results);
+  reader_destroy(&bread->reader);
+  if (bread->seen != NULL) {
+    string_set_destroy(bread->seen);
+    free(bread->seen);
+  }
+  candidate_vec_destroy(&bread->candidates);
+  desktop_vec_destroy(&bread->apps);
+  history_close(&bread->history);
+  string_vec_destroy(&bread->strings);
+  input_file_close(&bread->input_file);
+}
+
+/*
+ * Add whatever input has arrived to the candidates. They're matched against
+ * the query when the next frame is drawn.
+ */
+static void bread_read_input(struct bread *bread)
+{
+  const size_t first_string = bread->strings.count;
+  if (reader_read(&bread->reader, &bread->strings, bread->seen) > 0) {
+    bread_add_strings(bread, first_string);
+    bread->window->surface.redraw = true;
+  }
+  if (bread->reader.eof) {
+    log_debug("finished reading %zu candidates", bread->candidates.count);
+  }
+}
+
+/*
+ * Bring the results up to date with everything that's happened since the last
+ * frame, and draw the next one.
+ */
+static void bread_render(struct bread *bread)
+{
+  log_enter_context("bread_render");
+  struct surface *surface = &bread->window->surface;
+  surface->redraw = false;
+
+  if (bread->matched < bread->candidates.count) {
+    results_append(&bread->results, bread->matched);
+    bread->matched = bread->candidates.count;
+  }
+
+  /* However many keys were pressed since the last frame, match just once. */
+  if (bread->state.query_dirty) {
+    bread->state.query_dirty = false;
+    bread->state.selected = 0;
+    results_update(&bread->results, bread->state.query);
+  }
+
+  /* If every buffer's busy, this is tried again once one's released. */
+  if (surface_begin(surface) == NULL) {
+    log_leave_context();
+    return;
+  }
+  surface_draw(surface);
+  log_leave_context();
+}
+
+/*
+ * Handle Wayland events and input until the window is closed.
+ *
+ * Input is read as it arrives rather than all up front, so the window is
+ * usable straight away however slow whatever's piping it in is.
+ *
+ * Drawing is paced by the compositor's frame callbacks. Events and input just
+ * mark the window for redrawing, and everything that's happened since the last
+ * frame (new candidates, edits to the query) is dealt with in one go once the
+ * compositor's ready for another.
+ */
+void bread_run(struct bread *bread)
+{
+  log_enter_context("bread_run");
+  struct wl_display *display = bread->wayland.global.display;
+
+  struct pollfd pollfds[2] = {
+    {
+      .fd = wl_display_get_fd(display),
+      .events = POLLIN
+    },
+    {
+      .fd = bread->reader.fd,
+      .events = POLLIN
+    }
+  };
+
+  while (!bread->closed) {
+    while (wl_display_prepare_read(display) != 0) {
+      wl_display_dispatch_pending(display);
+    }
+    /*
+     * Keypresses only edit the query, so it's matched here, once every event
+     * that's arrived has been handled.
+     */
+    if (bread->state.query_dirty) {
+      bread->window->surface.redraw = true;
+    }
+    if (surface_frame_due(&bread->window->surface)) {
+      wl_display_cancel_read(display);
+      bread_render(bread);
+      continue;
+    }
+    wl_display_flush(display);
+
+    /*
+     * A negative fd is ignored, so stop polling input once it's done. The
+     * compositor doesn't send key repeats, so wake up for those too.
+     */
+    pollfds[1].fd = bread->reader.eof ? -1 : bread->reader.fd;
+    if (poll(pollfds, 2, keyboard_repeat_timeout(&bread->keyboard)) == -1) {
+      wl_display_cancel_read(display);
+      if (errno == EINTR) {
+        continue;
+      }
+      log_error("Error polling: %s.\n", strerror(errno));
+      break;
+    }
+
+    if (pollfds[0].revents & POLLIN) {
+      if (wl_display_read_events(display) == -1) {
+        log_error("Lost connection to the compositor.\n");
+        break;
+      }
+    } else {
+      wl_display_cancel_read(display);
+    }
+    wl_display_dispatch_pending(display);
 
-  setup_bread(&bread);
+    if (pollfds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+      bread_read_input(bread);
+    }
+    keyboard_repeat(&bread->keyboard);
+  }
 
   log_leave_context();
-  return bread;
 }
@@ -1,8 +1,18 @@
 #ifndef BREAD_H
 #define BREAD_H
 
+#include <stdbool.h>
+#include "candidate.h"
 #include "config.h"
+#include "desktop_vec.h"
+#include "history.h"
+#include "input_file.h"
 #include "keyboard.h"
+#include "reader.h"
+#include "result.h"
+#include "state.h"
+#include "string_set.h"
+#include "string_vec.h"
 #include "wayland.h"
 #include "window.h"
 
@@ -11,9 +21,25 @@ struct bread {
   struct wayland wayland;
   struct keyboard keyboard;
   struct window *window;
+  struct string_vec strings;
+  struct desktop_vec apps;
+  struct history history;
+  struct candidate_vec candidates;
+  struct reader reader;
+  struct input_file input_file;
+  /* Candidates read so far, if duplicates are being dropped. */
+  struct string_set *seen;
+  struct results results;
+  struct state state;
+  /* Candidates from here on have been read but not yet matched. */
+  size_t matched;
+  uint32_t num_results;
+  bool closed;
 };
 
-struct bread bread_create(struct config *conf);
+void bread_create(struct bread *bread, struct config *conf);
+void bread_run(struct bread *bread);
+void bread_destroy(struct bread *bread);
 
 #endif /* BREAD_H */
 
@@ -0,0 +1,174 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+#include "log.h"
+#include "xmalloc.h"
+
+/*
+ * Some filesystems only keep mtimes to the second (or worse), so a directory
+ * changed this close to being read might change again without its mtime
+ * moving.
+ */
+#define CACHE_RACY_SECONDS 1
+
+/*
+ * Return the path of the cache file called name, or NULL if there's nowhere
+ * to put it.
+ */
+char *cache_path(const char *name)
+{
+  const char *base = getenv("XDG_CACHE_HOME");
+  const char *suffix = "";
+  if (base == NULL || base[0] == '\0') {
+    base = getenv("HOME");
+    suffix = "/.cache";
+    if (base == NULL) {
+      return NULL;
+    }
+  }
+  size_t len = strlen(base) + strlen(suffix) + strlen("/bread/") + strlen(name) + 1;
+  char *path = xmalloc(len);
+  snprintf(path, len, "%s%s/bread/%s", base, suffix, name);
+  return path;
+}
+
+/*
+ * Map the cache file at path read-only. Returns false if it doesn't exist or
+ * can't be read, which callers should treat like an out of date cache.
+ */
+bool cache_map(struct cache *cache, const char *path)
+{
+  *cache = (struct cache){ 0 };
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  cache->data = data;
+  cache->size = st.st_size;
+  return true;
+}
+
+void cache_unmap(struct cache *cache)
+{
+  if (cache->data != NULL) {
+    munmap((void *)cache->data, cache->size);
+  }
+  cache->data = NULL;
+  cache->size = 0;
+}
+
+/* Create any missing directories leading up to the file at path. */
+static void make_parents(const char *path)
+{
+  char *tmp = xstrdup(path);
+  for (char *c = tmp + 1; *c != '\0'; c++) {
+    if (*c == '/') {
+      *c = '\0';
+      mkdir(tmp, 0700);
+      *c = '/';
+    }
+  }
+  free(tmp);
+}
+
+/*
+ * Replace the cache file at path with the contents of buffer.
+ *
+ * The new contents are written to a temporary file which is then renamed
+ * over the old one, so that other instances reading the cache never see a
+ * partial file.
+ */
+bool cache_write(const char *path, const struct cache_buffer *buffer)
+{
+  log_enter_context("cache_write");
+  make_parents(path);
+
+  size_t len = strlen(path) + strlen(".XXXXXX") + 1;
+  char *tmp = xmalloc(len);
+  snprintf(tmp, len, "%s.XXXXXX", path);
+  int fd = mkstemp(tmp);
+  if (fd == -1) {
+    log_warning("Couldn't create cache file %s: %s.\n", tmp, strerror(errno));
+    free(tmp);
+    log_leave_context();
+    return false;
+  }
+
+  bool ok = true;
+  for (size_t written = 0; ok && written < buffer->len;) {
+    ssize_t n = write(fd, &buffer->data[written], buffer->len - written);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    ok = n > 0;
+    written += ok ? n : 0;
+  }
+  ok = close(fd) == 0 && ok;
+  ok = ok && rename(tmp, path) == 0;
+  if (!ok) {
+    log_warning("Couldn't write cache file %s: %s.\n", path, strerror(errno));
+    unlink(tmp);
+  }
+
+  free(tmp);
+  log_leave_context();
+  return ok;
+}
+
+/*
+ * Return whether a directory with the given mtime, read at now, could still
+ * change without its mtime moving. What was read from it should then be
+ * cached with an mtime that never matches, so it's read again next time.
+ */
+bool cache_mtime_is_racy(struct timespec mtime, struct timespec now)
+{
+  return mtime.tv_sec >= now.tv_sec - CACHE_RACY_SECONDS;
+}
+
+/*
+ * Append len bytes of data to buffer, returning the offset they start at.
+ */
+size_t cache_buffer_append(
+    struct cache_buffer *buffer,
+    const void *data,
+    size_t len)
+{
+  const size_t offset = buffer->len;
+  if (len == 0) {
+    return offset;
+  }
+  if (buffer->len + len > buffer->size) {
+    buffer->size = 2 * (buffer->len + len) + 4096;
+    buffer->data = xrealloc(buffer->data, buffer->size);
+  }
+  memcpy(&buffer->data[offset], data, len);
+  buffer->len += len;
+  return offset;
+}
+
+void cache_buffer_destroy(struct cache_buffer *buffer)
+{
+  free(buffer->data);
+  buffer->data = NULL;
+  buffer->len = 0;
+  buffer->size = 0;
+}
@@ -0,0 +1,39 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+/*
+ * Helpers for the files we keep under $XDG_CACHE_HOME/bread to speed up
+ * startup. They're only ever a copy of something we can work out again, so
+ * any problem with them just means doing that.
+ */
+
+/* A cache file mapped into memory. */
+struct cache {
+  const char *data;
+  size_t size;
+};
+
+/* A cache file being built up in memory before it's written out. */
+struct cache_buffer {
+  char *data;
+  size_t len;
+  size_t size;
+};
+
+char *cache_path(const char *name);
+bool cache_map(struct cache *cache, const char *path);
+void cache_unmap(struct cache *cache);
+bool cache_write(const char *path, const struct cache_buffer *buffer);
+bool cache_mtime_is_racy(struct timespec mtime, struct timespec now);
+
+size_t cache_buffer_append(
+    struct cache_buffer *buffer,
+    const void *data,
+    size_t len);
+void cache_buffer_destroy(struct cache_buffer *buffer);
+
+#endif /* CACHE_H */
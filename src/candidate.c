@@ -0,0 +1,179 @@
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "candidate.h"
+#include "prefilter.h"
+#include "unicode.h"
+#include "xmalloc.h"
+
+#define CANDIDATE_VEC_BLOCK_SIZE (1 << 20)
+
+/*
+ * Convert a byte offset into candidate->folded into one into
+ * candidate->string.
+ */
+uint32_t candidate_offset(const struct candidate *candidate, uint32_t offset)
+{
+  if (candidate->map == NULL) {
+    return offset;
+  }
+  return candidate->map[offset];
+}
+
+/*
+ * Classify the character at c in string by its previous character.
+ * Returns a combination of enum candidate_boundary flags.
+ */
+uint8_t candidate_boundary(const char *string, const char *c)
+{
+  if (c == string) {
+    return 0;
+  }
+  const uint32_t cur = utf8_to_utf32(c);
+  const uint32_t prev = utf8_to_utf32(utf8_prev_char(c));
+  uint8_t boundary = 0;
+  if (utf32_isupper(cur) && utf32_islower(prev)) {
+    boundary |= CANDIDATE_BOUNDARY_CAMEL;
+  }
+  if (utf32_isalnum(cur) && !utf32_isalnum(prev)) {
+    boundary |= CANDIDATE_BOUNDARY_SEPARATOR;
+  }
+  return boundary;
+}
+
+/* Start a new block with room for at least size bytes. */
+static void new_block(struct candidate_vec *vec, size_t size)
+{
+  if (size < CANDIDATE_VEC_BLOCK_SIZE) {
+    size = CANDIDATE_VEC_BLOCK_SIZE;
+  }
+  vec->blocks = xrealloc(
+      vec->blocks,
+      (vec->num_blocks + 1) * sizeof(*vec->blocks));
+  vec->blocks[vec->num_blocks++] = xmalloc(size);
+  vec->block_used = 0;
+  vec->block_size = size;
+}
+
+/*
+ * Take size bytes from the end of the last block, aligned so that they can
+ * hold a map.
+ */
+static void *block_alloc(struct candidate_vec *vec, size_t size)
+{
+  const size_t align = alignof(uint32_t);
+  size_t offset = (vec->block_used + align - 1) & ~(align - 1);
+  if (vec->num_blocks == 0 || offset + size > vec->block_size) {
+    new_block(vec, size);
+    offset = 0;
+  }
+  vec->block_used = offset + size;
+  return &vec->blocks[vec->num_blocks - 1][offset];
+}
+
+/*
+ * Fold the first length bytes of string into the blocks of vec. Only a map
+ * that's needed is kept, and strings that are already folded aren't copied.
+ */
+static struct candidate candidate_prepare(
+    struct candidate_vec *vec,
+    const char *string,
+    size_t length)
+{
+  struct candidate candidate = {
+    .string = string,
+    .length = length
+  };
+
+  bool same_offsets;
+  candidate.folded_length = utf8_fold_length(string, length, &same_offsets);
+  if (!same_offsets) {
+    candidate.map = block_alloc(
+        vec,
+        (candidate.folded_length + 1) * sizeof(*candidate.map));
+  }
+  char *folded = block_alloc(vec, candidate.folded_length + 1);
+  utf8_fold_to(string, length, folded, candidate.map);
+  candidate.folded = folded;
+  candidate.folded_chars = utf8_strlen(folded);
+
+  /*
+   * No need to keep a second copy of strings that are already folded. As the
+   * copy's the last thing in the last block, its space can be reused.
+   */
+  if (candidate.map == NULL
+      && candidate.folded_length == length
+      && !memcmp(folded, string, length)) {
+    vec->block_used = folded - vec->blocks[vec->num_blocks - 1];
+    candidate.folded = string;
+  }
+
+  return candidate;
+}
+
+struct candidate_vec candidate_vec_create(void)
+{
+  struct candidate_vec vec = {
+    .count = 0,
+    .size = 128,
+    .by_weight = true
+  };
+  vec.buf = xcalloc(vec.size, sizeof(*vec.buf));
+  vec.signatures = xcalloc(vec.size, sizeof(*vec.signatures));
+  return vec;
+}
+
+void candidate_vec_destroy(struct candidate_vec *vec)
+{
+  for (size_t i = 0; i < vec->num_blocks; i++) {
+    free(vec->blocks[i]);
+  }
+  free(vec->blocks);
+  free(vec->buf);
+  free(vec->signatures);
+  vec->blocks = NULL;
+  vec->buf = NULL;
+  vec->signatures = NULL;
+  vec->num_blocks = 0;
+  vec->count = 0;
+  vec->size = 0;
+}
+
+/*
+ * Prepare the first length bytes of string and append them to vec. The string
+ * itself isn't copied, so must outlive vec.
+ */
+void candidate_vec_add(
+    struct candidate_vec *vec,
+    const char *string,
+    size_t length)
+{
+  candidate_vec_add_weighted(vec, string, length, 0);
+}
+
+/* As candidate_vec_add(), with weight added to the score of any match. */
+void candidate_vec_add_weighted(
+    struct candidate_vec *vec,
+    const char *string,
+    size_t length,
+    int32_t weight)
+{
+  if (vec->count == vec->size) {
+    vec->size *= 2;
+    vec->buf = xrealloc(vec->buf, vec->size * sizeof(*vec->buf));
+    vec->signatures = xrealloc(
+        vec->signatures,
+        vec->size * sizeof(*vec->signatures));
+  }
+  struct candidate *candidate = &vec->buf[vec->count];
+  *candidate = candidate_prepare(vec, string, length);
+  candidate->weight = weight;
+  if (vec->count > 0 && weight > vec->buf[vec->count - 1].weight) {
+    vec->by_weight = false;
+  }
+  vec->signatures[vec->count] = prefilter_signature(
+      candidate->folded,
+      candidate->folded_length);
+  vec->count++;
+}
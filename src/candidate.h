@@ -0,0 +1,88 @@
+#ifndef CANDIDATE_H
+#define CANDIDATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A string that can be searched for.
+ *
+ * Matching is done against a case-folded copy (see utf8_fold()), which is
+ * prepared once when the candidate is loaded rather than on every keypress.
+ * The original string is kept for display.
+ */
+struct candidate {
+  /* Not necessarily nul-terminated, e.g. when it's part of a mapped file. */
+  const char *string;
+  uint32_t length;
+  /*
+   * Only valid for folded_length bytes, as it may be string itself when
+   * that's already folded, so it mustn't be written to or passed to strlen().
+   */
+  const char *folded;
+  /*
+   * Byte offset into string of each byte of folded,
+   * or NULL if they're the same (see utf8_fold()).
+   */
+  uint32_t *map;
+  uint32_t folded_length;
+  uint32_t folded_chars;
+  /*
+   * Added to the score of every match, e.g. from how often it's been chosen
+   * before, so that it's worked out once rather than on every keypress.
+   */
+  int32_t weight;
+};
+
+/*
+ * The kinds of word boundary a character can sit on, which fuzzy matching
+ * gives bonuses for.
+ */
+enum candidate_boundary {
+  CANDIDATE_BOUNDARY_CAMEL = 1 << 0,
+  CANDIDATE_BOUNDARY_SEPARATOR = 1 << 1,
+};
+
+/*
+ * A growable list of candidates.
+ *
+ * The prefilter signature of each candidate is kept in its own array, so that
+ * they can all be scanned with SIMD loads.
+ *
+ * The folded strings and maps of the candidates are packed into large blocks,
+ * as in struct string_vec, rather than each being allocated separately.
+ */
+struct candidate_vec {
+  size_t count;
+  size_t size;
+  struct candidate *buf;
+  uint64_t *signatures;
+  char **blocks;
+  size_t num_blocks;
+  /* Space used in the last block, and its size. */
+  size_t block_used;
+  size_t block_size;
+  /*
+   * Whether the candidates are in order of weight, highest first, in which
+   * case they're already ranked for an empty query.
+   */
+  bool by_weight;
+};
+
+uint32_t candidate_offset(const struct candidate *candidate, uint32_t offset);
+uint8_t candidate_boundary(const char *string, const char *c);
+
+struct candidate_vec candidate_vec_create(void);
+void candidate_vec_destroy(struct candidate_vec *vec);
+void candidate_vec_add(
+    struct candidate_vec *vec,
+    const char *string,
+    size_t length);
+void candidate_vec_add_weighted(
+    struct candidate_vec *vec,
+    const char *string,
+    size_t length,
+    int32_t weight);
+
+#endif /* CANDIDATE_H */
@@ -0,0 +1,395 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+#include "compgen.h"
+#include "log.h"
+#include "string_set.h"
+#include "string_vec.h"
+#include "workers.h"
+#include "xmalloc.h"
+
+/*
+ * Directories are mostly waiting on the disk (or the network) rather than
+ * the CPU, so scan them all at once, up to a point.
+ */
+#define COMPGEN_MAX_THREADS 32
+
+/* Not every libc wraps getdents64, so we call it ourselves. */
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+/*
+ * A directory in PATH, whose executables are either scanned into names, or
+ * found in the cache as num_cached nul-terminated names starting at cached.
+ */
+struct path_dir {
+  const char *path;
+  struct timespec mtime;
+  bool exists;
+  bool scanned;
+  /* Whether the listing can't be trusted to match mtime next time. */
+  bool racy;
+  struct string_vec names;
+  const char *cached;
+  size_t num_cached;
+};
+
+struct scan_job {
+  struct path_dir *dirs;
+  size_t *todo;
+  size_t count;
+  atomic_size_t next;
+};
+
+/*
+ * The cache is a header, followed by a table of directories, followed by the
+ * strings they refer to by offset from the start of the file.
+ */
+#define COMPGEN_CACHE_MAGIC "bread-compgen-1"
+
+struct compgen_cache_header {
+  char magic[16];
+  uint64_t num_dirs;
+};
+
+struct compgen_cache_dir {
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t path;
+  uint64_t names;
+  uint64_t names_size;
+  uint64_t num_names;
+};
+
+/*
+ * Whether the entry d of the directory open as fd is a file we can execute.
+ * Most entries' types are known from the directory listing, so regular files
+ * only need an access check. Anything else that passes it could still be a
+ * directory, which needs a stat to rule out.
+ */
+static bool is_executable(int fd, const struct linux_dirent64 *d)
+{
+  if (d->d_type != DT_REG && d->d_type != DT_LNK && d->d_type != DT_UNKNOWN) {
+    return false;
+  }
+  if (faccessat(fd, d->d_name, X_OK, 0) == -1) {
+    return false;
+  }
+  if (d->d_type == DT_REG) {
+    return true;
+  }
+  struct stat st;
+  return fstatat(fd, d->d_name, &st, 0) == 0 && S_ISREG(st.st_mode);
+}
+
+static int compare_names(const void *a, const void *b)
+{
+  return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/* Add the executables in the directory at path to names, sorted. */
+static void scan_directory(const char *path, struct string_vec *names)
+{
+  int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) {
+    /* Nonexistent directories in PATH are common enough to ignore. */
+    return;
+  }
+
+  struct string_vec unsorted = string_vec_create();
+  alignas(struct linux_dirent64) char buf[32 << 10];
+  long n;
+  while ((n = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+    for (long offset = 0; offset < n;) {
+      const struct linux_dirent64 *d = (void *)&buf[offset];
+      offset += d->d_reclen;
+      if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, "..")) {
+        continue;
+      }
+      if (is_executable(fd, d)) {
+        string_vec_add(&unsorted, d->d_name, strlen(d->d_name), 0);
+      }
+    }
+  }
+  close(fd);
+
+  const char **sorted = xmalloc((unsorted.count + 1) * sizeof(*sorted));
+  for (size_t i = 0; i < unsorted.count; i++) {
+    sorted[i] = string_vec_get(&unsorted, i);
+  }
+  qsort(sorted, unsorted.count, sizeof(*sorted), compare_names);
+  for (size_t i = 0; i < unsorted.count; i++) {
+    string_vec_add(names, sorted[i], strlen(sorted[i]), 0);
+  }
+  free(sorted);
+  string_vec_destroy(&unsorted);
+}
+
+static void scan_job(void *data, size_t worker, size_t count)
+{
+  struct scan_job *job = data;
+
+  /*
+   * Hand out directories one at a time rather than in fixed shares, so
+   * one slow directory only holds up the worker scanning it.
+   */
+  size_t i;
+  while ((i = atomic_fetch_add(&job->next, 1)) < job->count) {
+    struct path_dir *dir = &job->dirs[job->todo[i]];
+    scan_directory(dir->path, &dir->names);
+  }
+}
+
+/* Scan the directories whose indices are in todo, all at once. */
+static void scan_directories(struct path_dir *dirs, size_t *todo, size_t count)
+{
+  struct scan_job job = {
+    .dirs = dirs,
+    .todo = todo,
+    .count = count
+  };
+  atomic_init(&job.next, 0);
+
+  size_t nthreads = count;
+  if (nthreads > COMPGEN_MAX_THREADS) {
+    nthreads = COMPGEN_MAX_THREADS;
+  }
+  if (nthreads > 1) {
+    struct workers *workers = workers_create(nthreads);
+    workers_run(workers, scan_job, &job);
+    workers_destroy(workers);
+  } else {
+    scan_job(&job, 0, 1);
+  }
+}
+
+/*
+ * Look up the up to date cache entry for dir, filling in its names if there
+ * is one. Anything that doesn't look right is treated as out of date.
+ */
+static bool find_cached(const struct cache *cache, struct path_dir *dir)
+{
+  if (cache->size < sizeof(struct compgen_cache_header)) {
+    return false;
+  }
+  const struct compgen_cache_header *header = (const void *)cache->data;
+  if (memcmp(header->magic, COMPGEN_CACHE_MAGIC, sizeof(header->magic))
+      || header->num_dirs > (cache->size - sizeof(*header)) / sizeof(struct compgen_cache_dir)) {
+    return false;
+  }
+  const struct compgen_cache_dir *entries = (const void *)&header[1];
+  for (size_t i = 0; i < header->num_dirs; i++) {
+    const struct compgen_cache_dir *entry = &entries[i];
+    if (entry->path >= cache->size
+        || entry->names > cache->size
+        || entry->names_size > cache->size - entry->names) {
+      return false;
+    }
+    const char *path = &cache->data[entry->path];
+    if (memchr(path, '\0', cache->size - entry->path) == NULL
+        || strcmp(path, dir->path)) {
+      continue;
+    }
+    if (entry->mtime_sec != dir->mtime.tv_sec
+        || entry->mtime_nsec != dir->mtime.tv_nsec) {
+      return false;
+    }
+
+    /* Make sure the names are all there and terminated. */
+    const char *names = &cache->data[entry->names];
+    size_t count = 0;
+    for (const char *c = names;
+        (c = memchr(c, '\0', &names[entry->names_size] - c)) != NULL;
+        c++) {
+      count++;
+    }
+    if (count != entry->num_names
+        || (entry->names_size > 0 && names[entry->names_size - 1] != '\0')) {
+      return false;
+    }
+    dir->cached = names;
+    dir->num_cached = count;
+    return true;
+  }
+  return false;
+}
+
+/* Write the cache for dirs, to be read back by find_cached() next time. */
+static void write_cache(const char *path, const struct path_dir *dirs, size_t count)
+{
+  struct cache_buffer buffer = { 0 };
+  struct compgen_cache_header header = {
+    .magic = COMPGEN_CACHE_MAGIC
+  };
+  for (size_t i = 0; i < count; i++) {
+    header.num_dirs += dirs[i].exists;
+  }
+  cache_buffer_append(&buffer, &header, sizeof(header));
+  const size_t table = buffer.len;
+  for (size_t i = 0; i < header.num_dirs; i++) {
+    struct compgen_cache_dir entry = { 0 };
+    cache_buffer_append(&buffer, &entry, sizeof(entry));
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    const struct path_dir *dir = &dirs[i];
+    if (!dir->exists) {
+      continue;
+    }
+    /* A racy listing is written with an mtime that never matches. */
+    struct compgen_cache_dir entry = {
+      .mtime_sec = dir->racy ? -1 : dir->mtime.tv_sec,
+      .mtime_nsec = dir->racy ? -1 : dir->mtime.tv_nsec,
+      .path = cache_buffer_append(&buffer, dir->path, strlen(dir->path) + 1),
+      .names = buffer.len
+    };
+    if (dir->scanned) {
+      for (size_t j = 0; j < dir->names.count; j++) {
+        cache_buffer_append(
+            &buffer,
+            string_vec_get(&dir->names, j),
+            dir->names.entries[j].length + 1);
+      }
+      entry.num_names = dir->names.count;
+    } else {
+      const char *end = dir->cached;
+      for (size_t j = 0; j < dir->num_cached; j++) {
+        end += strlen(end) + 1;
+      }
+      cache_buffer_append(&buffer, dir->cached, end - dir->cached);
+      entry.num_names = dir->num_cached;
+    }
+    entry.names_size = buffer.len - entry.names;
+    memcpy(&buffer.data[table + n++ * sizeof(entry)], &entry, sizeof(entry));
+  }
+
+  cache_write(path, &buffer);
+  cache_buffer_destroy(&buffer);
+}
+
+/*
+ * List the executables in PATH, each directory's sorted by name, and without
+ * any that are shadowed by one earlier in PATH.
+ *
+ * The listing of each directory is cached along with its mtime, which
+ * changes whenever anything is added to or removed from it, so usually only
+ * the directories need to be stat()ed. Directories changed just before
+ * being scanned are scanned again next time (see cache_mtime_is_racy()).
+ */
+struct string_vec compgen(void)
+{
+  log_enter_context("compgen");
+  struct string_vec commands = string_vec_create();
+
+  const char *env = getenv("PATH");
+  if (env == NULL) {
+    log_error("Couldn't retrieve PATH from environment.\n");
+    log_leave_context();
+    return commands;
+  }
+
+  /* Empty entries in PATH mean the working directory, which we skip. */
+  char *path = xstrdup(env);
+  size_t size = 1;
+  for (const char *c = path; *c != '\0'; c++) {
+    size += *c == ':';
+  }
+  struct path_dir *dirs = xcalloc(size, sizeof(*dirs));
+  size_t count = 0;
+  char *saveptr = NULL;
+  for (char *dir = strtok_r(path, ":", &saveptr);
+      dir != NULL;
+      dir = strtok_r(NULL, ":", &saveptr)) {
+    dirs[count].path = dir;
+    dirs[count].names = string_vec_create();
+    count++;
+  }
+
+  char *cache_file = cache_path("compgen");
+  struct cache cache = { 0 };
+  if (cache_file != NULL) {
+    cache_map(&cache, cache_file);
+  }
+
+  /* Nonexistent directories in PATH are common enough to ignore. */
+  size_t *todo = xcalloc(count + 1, sizeof(*todo));
+  size_t num_todo = 0;
+  for (size_t i = 0; i < count; i++) {
+    struct stat st;
+    dirs[i].exists = stat(dirs[i].path, &st) == 0 && S_ISDIR(st.st_mode);
+    if (!dirs[i].exists) {
+      continue;
+    }
+    dirs[i].mtime = st.st_mtim;
+    if (!find_cached(&cache, &dirs[i])) {
+      dirs[i].scanned = true;
+      todo[num_todo++] = i;
+    }
+  }
+  log_debug("%zu of %zu directories to scan", num_todo, count);
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  for (size_t i = 0; i < num_todo; i++) {
+    struct path_dir *dir = &dirs[todo[i]];
+    dir->racy = cache_mtime_is_racy(dir->mtime, now);
+  }
+  scan_directories(dirs, todo, num_todo);
+
+  /* Merge in PATH order, keeping only the first of each name. */
+  struct string_set seen = string_set_create();
+  for (size_t i = 0; i < count; i++) {
+    const struct path_dir *dir = &dirs[i];
+    const char *cached = dir->cached;
+    const size_t n = dir->scanned ? dir->names.count : dir->num_cached;
+    for (size_t j = 0; j < n; j++) {
+      const char *name;
+      size_t length;
+      if (dir->scanned) {
+        name = string_vec_get(&dir->names, j);
+        length = dir->names.entries[j].length;
+      } else {
+        name = cached;
+        length = strlen(cached);
+        cached += length + 1;
+      }
+      if (string_set_add(&seen, name, length)) {
+        string_vec_add(&commands, name, length, 0);
+      }
+    }
+  }
+  string_set_destroy(&seen);
+
+  if (cache_file != NULL && num_todo > 0) {
+    write_cache(cache_file, dirs, count);
+  }
+
+  cache_unmap(&cache);
+  free(cache_file);
+  for (size_t i = 0; i < count; i++) {
+    string_vec_destroy(&dirs[i].names);
+  }
+  free(todo);
+  free(dirs);
+  free(path);
+
+  log_debug("found %zu commands", commands.count);
+  log_leave_context();
+  return commands;
+}
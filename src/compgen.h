@@ -0,0 +1,8 @@
+#ifndef COMPGEN_H
+#define COMPGEN_H
+
+#include "string_vec.h"
+
+struct string_vec compgen(void);
+
+#endif /* COMPGEN_H */
@@ -1,13 +1,20 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 enum pos { START, CENTER, END };
 
+enum mode { MODE_DMENU, MODE_DRUN, MODE_RUN };
+
 struct config {
 
   uint32_t font_size;
+  uint32_t num_results;
+  enum mode mode;
+  const char *input_file;
+  bool dedup;
   uint32_t char_width;
   uint32_t char_height;
   enum pos horizontal_pos;
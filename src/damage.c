@@ -0,0 +1,156 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "damage.h"
+
+/* Assume 4 bytes per pixel for WL_SHM_FORMAT_ARGB8888 */
+#define DAMAGE_BYTES_PER_PIXEL 4
+
+#undef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#undef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+static int64_t area(struct damage_rect rect)
+{
+  return (int64_t)rect.width * rect.height;
+}
+
+static struct damage_rect rect_union(struct damage_rect a, struct damage_rect b)
+{
+  const int32_t x = MIN(a.x, b.x);
+  const int32_t y = MIN(a.y, b.y);
+  return (struct damage_rect){
+    .x = x,
+    .y = y,
+    .width = MAX(a.x + a.width, b.x + b.width) - x,
+    .height = MAX(a.y + a.height, b.y + b.height) - y
+  };
+}
+
+/*
+ * Whether two rectangles may as well be one, because their bounding box covers
+ * no more than they do separately (e.g. adjacent rows, or one inside another).
+ */
+static bool rect_mergeable(struct damage_rect a, struct damage_rect b)
+{
+  return area(rect_union(a, b)) <= area(a) + area(b);
+}
+
+static bool rect_contains(struct damage_rect outer, struct damage_rect inner)
+{
+  return outer.x <= inner.x && outer.y <= inner.y
+    && inner.x + inner.width <= outer.x + outer.width
+    && inner.y + inner.height <= outer.y + outer.height;
+}
+
+static void remove_rect(struct damage *damage, size_t i)
+{
+  damage->rects[i] = damage->rects[--damage->count];
+}
+
+void damage_clear(struct damage *damage)
+{
+  damage->count = 0;
+}
+
+/*
+ * Add a rectangle to the damage, clipped to a width x height surface.
+ *
+ * Rectangles are merged as they're added when that costs nothing extra, which
+ * for a launcher's stacked full-width rows usually leaves a handful of bands.
+ * Anything past DAMAGE_MAX_RECTS is folded into the rectangle it grows the
+ * least.
+ */
+void damage_add(
+    struct damage *damage,
+    struct damage_rect rect,
+    int32_t width,
+    int32_t height)
+{
+  const int32_t x0 = MAX(rect.x, 0);
+  const int32_t y0 = MAX(rect.y, 0);
+  const int32_t x1 = MIN((int64_t)rect.x + rect.width, width);
+  const int32_t y1 = MIN((int64_t)rect.y + rect.height, height);
+  if (x1 <= x0 || y1 <= y0) {
+    return;
+  }
+  rect = (struct damage_rect){ x0, y0, x1 - x0, y1 - y0 };
+
+  /* Keep merging until nothing else fits with the (growing) rectangle. */
+  size_t i = 0;
+  while (i < damage->count) {
+    if (rect_contains(damage->rects[i], rect)) {
+      return;
+    }
+    if (rect_mergeable(damage->rects[i], rect)) {
+      rect = rect_union(damage->rects[i], rect);
+      remove_rect(damage, i);
+      i = 0;
+      continue;
+    }
+    i++;
+  }
+
+  if (damage->count < DAMAGE_MAX_RECTS) {
+    damage->rects[damage->count++] = rect;
+    return;
+  }
+
+  size_t best = 0;
+  int64_t best_growth = INT64_MAX;
+  for (size_t j = 0; j < damage->count; j++) {
+    const struct damage_rect merged = rect_union(damage->rects[j], rect);
+    const int64_t growth = area(merged) - area(damage->rects[j]);
+    if (growth < best_growth) {
+      best = j;
+      best_growth = growth;
+    }
+  }
+  rect = rect_union(damage->rects[best], rect);
+  remove_rect(damage, best);
+  /* The merged rectangle may now fit with others, so add it afresh. */
+  damage_add(damage, rect, width, height);
+}
+
+void damage_add_all(struct damage *damage, int32_t width, int32_t height)
+{
+  damage->count = 0;
+  damage_add(damage, (struct damage_rect){ 0, 0, width, height }, width, height);
+}
+
+/* Whether a single damaged rectangle covers all of rect. */
+bool damage_covers(const struct damage *damage, struct damage_rect rect)
+{
+  for (size_t i = 0; i < damage->count; i++) {
+    if (rect_contains(damage->rects[i], rect)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Copy the damaged regions of one buffer into another of the same layout. */
+void damage_copy(
+    const struct damage *damage,
+    uint8_t *restrict dst,
+    const uint8_t *restrict src,
+    int32_t stride)
+{
+  for (size_t i = 0; i < damage->count; i++) {
+    const struct damage_rect rect = damage->rects[i];
+    const size_t offset =
+      (size_t)rect.y * stride + (size_t)rect.x * DAMAGE_BYTES_PER_PIXEL;
+    const size_t length = (size_t)rect.width * DAMAGE_BYTES_PER_PIXEL;
+    if (rect.x == 0 && length == (size_t)stride) {
+      /* Full rows are contiguous, so can go in one go. */
+      memcpy(dst + offset, src + offset, length * rect.height);
+      continue;
+    }
+    for (int32_t row = 0; row < rect.height; row++) {
+      const size_t start = offset + (size_t)row * stride;
+      memcpy(dst + start, src + start, length);
+    }
+  }
+}
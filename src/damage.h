@@ -0,0 +1,42 @@
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Past this many rectangles, new damage is merged into whichever rectangle it
+ * grows the least, so a frame never has more regions to submit or copy.
+ */
+#define DAMAGE_MAX_RECTS 8
+
+struct damage_rect {
+  int32_t x;
+  int32_t y;
+  int32_t width;
+  int32_t height;
+};
+
+/* The regions of a surface that changed in one frame. */
+struct damage {
+  size_t count;
+  struct damage_rect rects[DAMAGE_MAX_RECTS];
+};
+
+void damage_clear(struct damage *damage);
+void damage_add(
+    struct damage *damage,
+    struct damage_rect rect,
+    int32_t width,
+    int32_t height);
+void damage_add_all(struct damage *damage, int32_t width, int32_t height);
+[[nodiscard]]
+bool damage_covers(const struct damage *damage, struct damage_rect rect);
+void damage_copy(
+    const struct damage *damage,
+    uint8_t *restrict dst,
+    const uint8_t *restrict src,
+    int32_t stride);
+
+#endif /* DAMAGE_H */
@@ -0,0 +1,251 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "desktop_file.h"
+#include "desktop_vec.h"
+
+/*
+ * Add lang, country and modifier, run together, to the names to look for,
+ * unless it's already there. Names too long to keep are skipped rather than
+ * kept cut short, as a cut-short name could match the wrong translation.
+ */
+static void add_locale(
+    struct desktop_locale *locale,
+    const char *lang,
+    const char *country,
+    const char *modifier)
+{
+  char *name = locale->names[locale->count];
+  const int len = snprintf(
+      name,
+      sizeof(locale->names[0]),
+      "%s%s%s",
+      lang,
+      country,
+      modifier);
+  if (len < 0 || (size_t)len >= sizeof(locale->names[0])) {
+    return;
+  }
+  for (size_t i = 0; i < locale->count; i++) {
+    if (!strcmp(locale->names[i], name)) {
+      return;
+    }
+  }
+  locale->count++;
+}
+
+/*
+ * Work out which translations to use for the LC_MESSAGES locale, following
+ * the matching rules of the Desktop Entry Specification.
+ */
+struct desktop_locale desktop_locale_create(const char *name)
+{
+  struct desktop_locale locale = { 0 };
+  char lang[sizeof(locale.names[0])];
+  if (name == NULL
+      || !strcmp(name, "C")
+      || !strcmp(name, "POSIX")
+      || strlen(name) >= sizeof(lang)) {
+    return locale;
+  }
+
+  char country[64] = "";
+  char modifier[64] = "";
+  snprintf(lang, sizeof(lang), "%s", name);
+  char *c = strchr(lang, '@');
+  if (c != NULL) {
+    snprintf(modifier, sizeof(modifier), "%s", c);
+    *c = '\0';
+  }
+  c = strchr(lang, '.');
+  if (c != NULL) {
+    *c = '\0';
+  }
+  c = strchr(lang, '_');
+  if (c != NULL) {
+    snprintf(country, sizeof(country), "%s", c);
+    *c = '\0';
+  }
+
+  if (country[0] != '\0' && modifier[0] != '\0') {
+    add_locale(&locale, lang, country, modifier);
+  }
+  if (country[0] != '\0') {
+    add_locale(&locale, lang, country, "");
+  }
+  if (modifier[0] != '\0') {
+    add_locale(&locale, lang, "", modifier);
+  }
+  add_locale(&locale, lang, "", "");
+  return locale;
+}
+
+/* Replace the escape sequences in the nul-terminated value, in place. */
+static void unescape(char *value)
+{
+  char *out = value;
+  for (const char *c = value; *c != '\0'; c++) {
+    if (*c != '\\' || c[1] == '\0') {
+      *out++ = *c;
+      continue;
+    }
+    switch (*++c) {
+      case 's':
+        *out++ = ' ';
+        break;
+      case 'n':
+        *out++ = '\n';
+        break;
+      case 't':
+        *out++ = '\t';
+        break;
+      case 'r':
+        *out++ = '\r';
+        break;
+      default:
+        *out++ = *c;
+        break;
+    }
+  }
+  *out = '\0';
+}
+
+/*
+ * How well the translation for locale_name matches, lower being better, or
+ * -1 if it doesn't. Untranslated values match worst of all.
+ */
+static int locale_rank(const struct desktop_locale *locale, const char *locale_name)
+{
+  if (locale_name == NULL) {
+    return DESKTOP_LOCALE_MAX;
+  }
+  for (size_t i = 0; i < locale->count; i++) {
+    if (!strcmp(locale->names[i], locale_name)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Keep value in *dest if it's a better translation than what's there. */
+static void set_localized(const char **dest, int *best, int rank, char *value)
+{
+  if (rank >= 0 && rank < *best) {
+    unescape(value);
+    *dest = value;
+    *best = rank;
+  }
+}
+
+static bool parse_bool(const char *value)
+{
+  return !strcmp(value, "true") || !strcmp(value, "1");
+}
+
+/*
+ * Parse the desktop file in data into entry, whose strings all end up
+ * pointing into data, which is modified in place. data[length] must be
+ * '\0'. Only the keys of the [Desktop Entry] group that we use are looked
+ * at.
+ *
+ * Returns false if it isn't an application that should be listed at all.
+ */
+bool desktop_file_parse(
+    char *data,
+    size_t length,
+    const struct desktop_locale *locale,
+    struct desktop_entry *entry)
+{
+  const char *type = NULL;
+  bool hidden = false;
+  int name_rank = DESKTOP_LOCALE_MAX + 1;
+  int localized_name_rank = DESKTOP_LOCALE_MAX;
+  int generic_name_rank = DESKTOP_LOCALE_MAX + 1;
+  int keywords_rank = DESKTOP_LOCALE_MAX + 1;
+  bool in_group = false;
+
+  const char *end = data + length;
+  for (char *line = data; line < end;) {
+    char *eol = memchr(line, '\n', end - line);
+    if (eol == NULL) {
+      eol = data + length;
+    }
+    char *next = eol + 1;
+    if (eol > line && eol[-1] == '\r') {
+      eol--;
+    }
+    *eol = '\0';
+
+    if (line[0] == '[') {
+      /* Anything after the [Desktop Entry] group is no use to us. */
+      if (in_group) {
+        break;
+      }
+      in_group = !strcmp(line, "[Desktop Entry]");
+      line = next;
+      continue;
+    }
+    char *eq = strchr(line, '=');
+    if (!in_group || line[0] == '#' || eq == NULL) {
+      line = next;
+      continue;
+    }
+
+    char *key_end = eq;
+    while (key_end > line && key_end[-1] == ' ') {
+      key_end--;
+    }
+    *key_end = '\0';
+    char *value = eq + 1;
+    while (*value == ' ' || *value == '\t') {
+      value++;
+    }
+    const char *locale_name = NULL;
+    char *bracket = strchr(line, '[');
+    if (bracket != NULL && key_end > bracket && key_end[-1] == ']') {
+      *bracket = '\0';
+      key_end[-1] = '\0';
+      locale_name = bracket + 1;
+    }
+    const char *key = line;
+    const int rank = locale_rank(locale, locale_name);
+
+    if (!strcmp(key, "Name")) {
+      if (locale_name == NULL) {
+        set_localized(&entry->name, &name_rank, rank, value);
+      } else {
+        set_localized(&entry->localized_name, &localized_name_rank, rank, value);
+      }
+    } else if (!strcmp(key, "GenericName")) {
+      set_localized(&entry->generic_name, &generic_name_rank, rank, value);
+    } else if (!strcmp(key, "Keywords")) {
+      set_localized(&entry->keywords, &keywords_rank, rank, value);
+    } else if (locale_name != NULL) {
+      /* None of the other keys we need are translated. */
+    } else if (!strcmp(key, "Type")) {
+      type = value;
+    } else if (!strcmp(key, "Exec")) {
+      unescape(value);
+      entry->exec = value;
+    } else if (!strcmp(key, "Icon")) {
+      unescape(value);
+      entry->icon = value;
+    } else if (!strcmp(key, "Hidden")) {
+      hidden = parse_bool(value);
+    } else if (!strcmp(key, "NoDisplay")) {
+      entry->no_display = parse_bool(value);
+    }
+    line = next;
+  }
+
+  if (type == NULL || strcmp(type, "Application") || hidden) {
+    return false;
+  }
+  if (entry->localized_name != NULL
+      && entry->name != NULL
+      && !strcmp(entry->localized_name, entry->name)) {
+    entry->localized_name = NULL;
+  }
+  return true;
+}
@@ -0,0 +1,26 @@
+#ifndef DESKTOP_FILE_H
+#define DESKTOP_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "desktop_vec.h"
+
+#define DESKTOP_LOCALE_MAX 4
+
+/*
+ * The locale names to look for translations under, best match first, e.g.
+ * for "de_DE.UTF-8@euro" they're "de_DE@euro", "de_DE", "de@euro" and "de".
+ */
+struct desktop_locale {
+  char names[DESKTOP_LOCALE_MAX][64];
+  size_t count;
+};
+
+struct desktop_locale desktop_locale_create(const char *locale);
+bool desktop_file_parse(
+    char *data,
+    size_t length,
+    const struct desktop_locale *locale,
+    struct desktop_entry *entry);
+
+#endif /* DESKTOP_FILE_H */
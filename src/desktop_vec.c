@@ -0,0 +1,97 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "desktop_vec.h"
+#include "string_vec.h"
+#include "xmalloc.h"
+
+struct desktop_vec desktop_vec_create(void)
+{
+  struct desktop_vec vec = {
+    .count = 0,
+    .size = 128,
+    .strings = string_vec_create()
+  };
+  vec.buf = xcalloc(vec.size, sizeof(*vec.buf));
+  return vec;
+}
+
+void desktop_vec_destroy(struct desktop_vec *vec)
+{
+  free(vec->buf);
+  string_vec_destroy(&vec->strings);
+  cache_unmap(&vec->cache);
+  vec->buf = NULL;
+  vec->count = 0;
+  vec->size = 0;
+}
+
+/* Copy string into vec's own storage, keeping NULL as NULL. */
+static const char *copy_string(struct desktop_vec *vec, const char *string)
+{
+  if (string == NULL) {
+    return NULL;
+  }
+  size_t index = string_vec_add(&vec->strings, string, strlen(string), 0);
+  return string_vec_get(&vec->strings, index);
+}
+
+/*
+ * Add entry to vec as is, without copying its strings, which must outlive
+ * vec (e.g. by being part of vec->cache).
+ */
+void desktop_vec_add_mapped(struct desktop_vec *vec, const struct desktop_entry *entry)
+{
+  if (vec->count == vec->size) {
+    vec->size *= 2;
+    vec->buf = xrealloc(vec->buf, vec->size * sizeof(*vec->buf));
+  }
+  vec->buf[vec->count++] = *entry;
+}
+
+/* Add a copy of entry, and of all its strings, to vec. */
+void desktop_vec_add(struct desktop_vec *vec, const struct desktop_entry *entry)
+{
+  struct desktop_entry copy = {
+    .id = copy_string(vec, entry->id),
+    .path = copy_string(vec, entry->path),
+    .name = copy_string(vec, entry->name),
+    .localized_name = copy_string(vec, entry->localized_name),
+    .generic_name = copy_string(vec, entry->generic_name),
+    .keywords = copy_string(vec, entry->keywords),
+    .exec = copy_string(vec, entry->exec),
+    .icon = copy_string(vec, entry->icon),
+    .no_display = entry->no_display
+  };
+  desktop_vec_add_mapped(vec, &copy);
+}
+
+/* The name to show for entry. */
+const char *desktop_entry_name(const struct desktop_entry *entry)
+{
+  if (entry->localized_name != NULL) {
+    return entry->localized_name;
+  }
+  if (entry->name != NULL) {
+    return entry->name;
+  }
+  return entry->id;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+  const struct desktop_entry *ea = a;
+  const struct desktop_entry *eb = b;
+  int cmp = strcmp(desktop_entry_name(ea), desktop_entry_name(eb));
+  if (cmp == 0) {
+    cmp = strcmp(ea->id, eb->id);
+  }
+  return cmp;
+}
+
+/* Sort vec by name, with ids to break ties. */
+void desktop_vec_sort(struct desktop_vec *vec)
+{
+  qsort(vec->buf, vec->count, sizeof(*vec->buf), compare_entries);
+}
@@ -0,0 +1,49 @@
+#ifndef DESKTOP_VEC_H
+#define DESKTOP_VEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "cache.h"
+#include "string_vec.h"
+
+/*
+ * The parts of a .desktop file we need to show, match and launch an
+ * application. Any of the strings other than id and path may be NULL if the
+ * file doesn't have them.
+ */
+struct desktop_entry {
+  const char *id;
+  const char *path;
+  const char *name;
+  /* Name for the current locale, if there's a translation. */
+  const char *localized_name;
+  const char *generic_name;
+  const char *keywords;
+  const char *exec;
+  const char *icon;
+  bool no_display;
+};
+
+/*
+ * A growable list of desktop entries.
+ *
+ * The strings of entries that were parsed are copied into strings. Those that
+ * were loaded from the cache point straight into its mapping instead, which
+ * is kept for as long as the list.
+ */
+struct desktop_vec {
+  size_t count;
+  size_t size;
+  struct desktop_entry *buf;
+  struct string_vec strings;
+  struct cache cache;
+};
+
+struct desktop_vec desktop_vec_create(void);
+void desktop_vec_destroy(struct desktop_vec *vec);
+void desktop_vec_add(struct desktop_vec *vec, const struct desktop_entry *entry);
+void desktop_vec_add_mapped(struct desktop_vec *vec, const struct desktop_entry *entry);
+void desktop_vec_sort(struct desktop_vec *vec);
+const char *desktop_entry_name(const struct desktop_entry *entry);
+
+#endif /* DESKTOP_VEC_H */
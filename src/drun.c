@@ -0,0 +1,567 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <fts.h>
+#include <locale.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+#include "desktop_file.h"
+#include "desktop_vec.h"
+#include "drun.h"
+#include "log.h"
+#include "string_set.h"
+#include "string_vec.h"
+#include "workers.h"
+#include "xmalloc.h"
+
+/*
+ * Below this many desktop files, starting threads to parse them takes longer
+ * than parsing them.
+ */
+#define DRUN_MIN_PARALLEL_FILES 64
+
+/*
+ * A directory that desktop files were found under. The first few are the
+ * applications directories themselves, in order of priority, which may not
+ * exist. The rest are their subdirectories.
+ */
+struct app_dir {
+  char *path;
+  struct timespec mtime;
+  bool exists;
+};
+
+struct app_dirs {
+  size_t count;
+  size_t size;
+  struct app_dir *buf;
+  size_t num_roots;
+};
+
+/*
+ * The cache is a header, followed by a table of directories, then a table of
+ * entries, then the strings they refer to by offset from the start of the
+ * file. An offset of 0 means there's no string.
+ */
+static const char drun_cache_magic[16] = "bread-drun-1";
+
+struct drun_cache_header {
+  char magic[16];
+  /* The LC_MESSAGES locale that names were translated for. */
+  uint64_t locale;
+  uint64_t num_roots;
+  uint64_t num_dirs;
+  uint64_t num_entries;
+  uint64_t strings;
+};
+
+struct drun_cache_dir {
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t path;
+  uint64_t exists;
+};
+
+struct drun_cache_entry {
+  uint64_t id;
+  uint64_t path;
+  uint64_t name;
+  uint64_t localized_name;
+  uint64_t generic_name;
+  uint64_t keywords;
+  uint64_t exec;
+  uint64_t icon;
+  uint64_t no_display;
+};
+
+/* Add the directory at path, given its stat() or NULL if it doesn't exist. */
+static void app_dirs_add(struct app_dirs *dirs, char *path, const struct stat *st)
+{
+  if (dirs->count == dirs->size) {
+    dirs->size = dirs->size ? 2 * dirs->size : 16;
+    dirs->buf = xrealloc(dirs->buf, dirs->size * sizeof(*dirs->buf));
+  }
+  struct app_dir *dir = &dirs->buf[dirs->count++];
+  *dir = (struct app_dir){ .path = path };
+  if (st != NULL && S_ISDIR(st->st_mode)) {
+    dir->exists = true;
+    dir->mtime = st->st_mtim;
+  }
+}
+
+static void app_dirs_destroy(struct app_dirs *dirs)
+{
+  for (size_t i = 0; i < dirs->count; i++) {
+    free(dirs->buf[i].path);
+  }
+  free(dirs->buf);
+}
+
+static void add_root(struct app_dirs *dirs, const char *base, const char *suffix)
+{
+  size_t len = strlen(base) + strlen(suffix) + strlen("/applications") + 1;
+  char *path = xmalloc(len);
+  snprintf(path, len, "%s%s/applications", base, suffix);
+  struct stat st;
+  app_dirs_add(dirs, path, stat(path, &st) == 0 ? &st : NULL);
+}
+
+/* Find the applications directories, highest priority first. */
+static struct app_dirs find_roots(void)
+{
+  struct app_dirs dirs = { 0 };
+
+  const char *data_home = getenv("XDG_DATA_HOME");
+  if (data_home != NULL && data_home[0] != '\0') {
+    add_root(&dirs, data_home, "");
+  } else if (getenv("HOME") != NULL) {
+    add_root(&dirs, getenv("HOME"), "/.local/share");
+  }
+
+  const char *data_dirs = getenv("XDG_DATA_DIRS");
+  if (data_dirs == NULL || data_dirs[0] == '\0') {
+    data_dirs = "/usr/local/share:/usr/share";
+  }
+  char *tmp = xstrdup(data_dirs);
+  char *saveptr = NULL;
+  for (char *dir = strtok_r(tmp, ":", &saveptr);
+      dir != NULL;
+      dir = strtok_r(NULL, ":", &saveptr)) {
+    add_root(&dirs, dir, "");
+  }
+  free(tmp);
+
+  dirs.num_roots = dirs.count;
+  return dirs;
+}
+
+/* A desktop file found by walking the applications directories. */
+struct app_file {
+  const char *path;
+  const char *id;
+};
+
+struct app_files {
+  size_t count;
+  size_t size;
+  struct app_file *buf;
+  /* Where path and id of each file are kept. */
+  struct string_vec strings;
+};
+
+/*
+ * Find the desktop files under the applications directory root, noting the
+ * subdirectories they're in.
+ *
+ * Desktop files earlier in the search shadow any later ones with the same
+ * id, i.e. path relative to root with '/' replaced by '-'. This includes
+ * when they're hidden or not applications, as that's how users remove
+ * system entries, so the ids of every desktop file go into seen.
+ */
+static void find_files(
+    struct app_files *files,
+    struct app_dirs *dirs,
+    struct string_set *seen,
+    const char *root)
+{
+  char *paths[] = { (char *)root, NULL };
+  FTS *fts = fts_open(paths, FTS_LOGICAL | FTS_NOCHDIR, NULL);
+  if (fts == NULL) {
+    return;
+  }
+  const size_t root_len = strlen(root);
+  const char *ext = ".desktop";
+  const size_t ext_len = strlen(ext);
+
+  FTSENT *ent;
+  while ((ent = fts_read(fts)) != NULL) {
+    if (ent->fts_level > 0 && ent->fts_name[0] == '.') {
+      fts_set(fts, ent, FTS_SKIP);
+      continue;
+    }
+    if (ent->fts_info == FTS_D && ent->fts_level > 0) {
+      app_dirs_add(dirs, xstrdup(ent->fts_path), ent->fts_statp);
+      continue;
+    }
+    if (ent->fts_info != FTS_F
+        || ent->fts_namelen <= ext_len
+        || strcmp(&ent->fts_name[ent->fts_namelen - ext_len], ext)) {
+      continue;
+    }
+
+    const char *relative = &ent->fts_path[root_len + 1];
+    size_t id_len = strlen(relative);
+    size_t index = string_vec_add(&files->strings, relative, id_len, 0);
+    char *id = (char *)string_vec_get(&files->strings, index);
+    for (char *c = id; *c != '\0'; c++) {
+      if (*c == '/') {
+        *c = '-';
+      }
+    }
+    if (!string_set_add(seen, id, id_len)) {
+      continue;
+    }
+    index = string_vec_add(&files->strings, ent->fts_path, ent->fts_pathlen, 0);
+
+    if (files->count == files->size) {
+      files->size = files->size ? 2 * files->size : 256;
+      files->buf = xrealloc(files->buf, files->size * sizeof(*files->buf));
+    }
+    files->buf[files->count++] = (struct app_file){
+      .path = string_vec_get(&files->strings, index),
+      .id = id
+    };
+  }
+  fts_close(fts);
+}
+
+/*
+ * What each worker parsing desktop files keeps to itself: somewhere to read
+ * them into, and the entries it's parsed so far.
+ */
+struct parse_worker {
+  char *buf;
+  size_t size;
+  struct desktop_vec apps;
+};
+
+struct parse_job {
+  const struct app_file *files;
+  size_t count;
+  atomic_size_t next;
+  const struct desktop_locale *locale;
+  struct parse_worker *workers;
+};
+
+/* Read the file at path into worker->buf, nul-terminated. */
+static bool read_file(struct parse_worker *worker, const char *path, size_t *length)
+{
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return false;
+  }
+  if ((size_t)st.st_size + 1 > worker->size) {
+    worker->size = st.st_size + 1;
+    worker->buf = xrealloc(worker->buf, worker->size);
+  }
+
+  size_t len = 0;
+  while (len < worker->size - 1) {
+    ssize_t n = read(fd, &worker->buf[len], worker->size - 1 - len);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    len += n;
+  }
+  close(fd);
+  worker->buf[len] = '\0';
+  *length = len;
+  return true;
+}
+
+static void parse_job(void *data, size_t worker_index, size_t count)
+{
+  struct parse_job *job = data;
+  struct parse_worker *worker = &job->workers[worker_index];
+
+  /* Desktop files vary a lot in size, so hand them out one at a time. */
+  size_t i;
+  while ((i = atomic_fetch_add(&job->next, 1)) < job->count) {
+    const struct app_file *file = &job->files[i];
+    size_t length;
+    if (!read_file(worker, file->path, &length)) {
+      continue;
+    }
+    struct desktop_entry entry = {
+      .id = file->id,
+      .path = file->path
+    };
+    if (desktop_file_parse(worker->buf, length, job->locale, &entry)) {
+      desktop_vec_add(&worker->apps, &entry);
+    }
+  }
+}
+
+/*
+ * Parse every desktop file, noting the subdirectories they're in.
+ *
+ * The directories are walked first to work out which files are shadowed, so
+ * that the rest can be parsed in any order, all at once.
+ */
+static void scan(struct desktop_vec *apps, struct app_dirs *dirs, const char *locale_name)
+{
+  struct app_files files = { .strings = string_vec_create() };
+  struct string_set seen = string_set_create();
+  for (size_t i = 0; i < dirs->num_roots; i++) {
+    if (dirs->buf[i].exists) {
+      find_files(&files, dirs, &seen, dirs->buf[i].path);
+    }
+  }
+  string_set_destroy(&seen);
+
+  const struct desktop_locale locale = desktop_locale_create(locale_name);
+  struct parse_job job = {
+    .files = files.buf,
+    .count = files.count,
+    .locale = &locale
+  };
+  atomic_init(&job.next, 0);
+
+  struct workers *workers = NULL;
+  size_t nthreads = 1;
+  if (files.count >= DRUN_MIN_PARALLEL_FILES) {
+    workers = workers_create(0);
+    nthreads = workers->count;
+  }
+  job.workers = xcalloc(nthreads, sizeof(*job.workers));
+  for (size_t i = 0; i < nthreads; i++) {
+    job.workers[i].apps = desktop_vec_create();
+  }
+  if (workers != NULL) {
+    workers_run(workers, parse_job, &job);
+    workers_destroy(workers);
+  } else {
+    parse_job(&job, 0, 1);
+  }
+
+  for (size_t i = 0; i < nthreads; i++) {
+    struct parse_worker *worker = &job.workers[i];
+    for (size_t j = 0; j < worker->apps.count; j++) {
+      desktop_vec_add(apps, &worker->apps.buf[j]);
+    }
+    desktop_vec_destroy(&worker->apps);
+    free(worker->buf);
+  }
+  free(job.workers);
+  free(files.buf);
+  string_vec_destroy(&files.strings);
+  desktop_vec_sort(apps);
+}
+
+/* Return the string at offset in cache, or NULL for offset 0. */
+static const char *cached_string(const struct cache *cache, uint64_t offset)
+{
+  return offset == 0 ? NULL : &cache->data[offset];
+}
+
+static bool valid_string(const struct drun_cache_header *header, size_t size, uint64_t offset)
+{
+  return offset == 0 || (offset >= header->strings && offset < size);
+}
+
+/*
+ * Load apps from the cache in apps->cache, if it's still up to date with
+ * the applications directories in roots. Anything that doesn't look right is
+ * treated as out of date.
+ */
+static bool load_cache(struct desktop_vec *apps, const struct app_dirs *roots, const char *locale)
+{
+  const struct cache *cache = &apps->cache;
+  const size_t size = cache->size;
+  if (size < sizeof(struct drun_cache_header) || cache->data[size - 1] != '\0') {
+    return false;
+  }
+  const struct drun_cache_header *header = (const void *)cache->data;
+  if (memcmp(header->magic, drun_cache_magic, sizeof(header->magic))
+      || header->strings > size
+      || header->num_dirs > header->strings / sizeof(struct drun_cache_dir)
+      || header->num_entries > header->strings / sizeof(struct drun_cache_entry)
+      || sizeof(*header)
+        + header->num_dirs * sizeof(struct drun_cache_dir)
+        + header->num_entries * sizeof(struct drun_cache_entry) > header->strings
+      || header->num_roots != roots->num_roots
+      || header->num_roots > header->num_dirs
+      || !valid_string(header, size, header->locale)
+      || header->locale == 0
+      || strcmp(cached_string(cache, header->locale), locale)) {
+    return false;
+  }
+
+  /*
+   * Every directory that desktop files were found in must be unchanged, as
+   * must whether each applications directory exists, as any file being
+   * added, removed or renamed changes the mtime of the directory it's in.
+   */
+  const struct drun_cache_dir *dirs = (const void *)&header[1];
+  for (size_t i = 0; i < header->num_dirs; i++) {
+    if (dirs[i].path == 0 || !valid_string(header, size, dirs[i].path)) {
+      return false;
+    }
+    const char *path = cached_string(cache, dirs[i].path);
+    struct stat st;
+    bool exists = stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+    if (i < roots->num_roots && strcmp(path, roots->buf[i].path)) {
+      return false;
+    }
+    if (exists != (bool)dirs[i].exists) {
+      return false;
+    }
+    if (exists
+        && (st.st_mtim.tv_sec != dirs[i].mtime_sec
+          || st.st_mtim.tv_nsec != dirs[i].mtime_nsec)) {
+      return false;
+    }
+  }
+
+  const struct drun_cache_entry *entries = (const void *)&dirs[header->num_dirs];
+  for (size_t i = 0; i < header->num_entries; i++) {
+    const struct drun_cache_entry *e = &entries[i];
+    if (e->id == 0 || e->path == 0
+        || !valid_string(header, size, e->id)
+        || !valid_string(header, size, e->path)
+        || !valid_string(header, size, e->name)
+        || !valid_string(header, size, e->localized_name)
+        || !valid_string(header, size, e->generic_name)
+        || !valid_string(header, size, e->keywords)
+        || !valid_string(header, size, e->exec)
+        || !valid_string(header, size, e->icon)) {
+      apps->count = 0;
+      return false;
+    }
+    struct desktop_entry entry = {
+      .id = cached_string(cache, e->id),
+      .path = cached_string(cache, e->path),
+      .name = cached_string(cache, e->name),
+      .localized_name = cached_string(cache, e->localized_name),
+      .generic_name = cached_string(cache, e->generic_name),
+      .keywords = cached_string(cache, e->keywords),
+      .exec = cached_string(cache, e->exec),
+      .icon = cached_string(cache, e->icon),
+      .no_display = e->no_display
+    };
+    desktop_vec_add_mapped(apps, &entry);
+  }
+  return true;
+}
+
+static uint64_t append_string(struct cache_buffer *buffer, const char *string)
+{
+  if (string == NULL) {
+    return 0;
+  }
+  return cache_buffer_append(buffer, string, strlen(string) + 1);
+}
+
+/*
+ * Write the cache for apps, to be read back by load_cache() next time.
+ * Directories changed too close to now to trust their mtimes are written
+ * with ones that never match, so they're parsed again.
+ */
+static void write_cache(
+    const char *path,
+    const struct desktop_vec *apps,
+    const struct app_dirs *dirs,
+    const char *locale,
+    struct timespec now)
+{
+  struct cache_buffer buffer = { 0 };
+  struct drun_cache_header header = {
+    .num_roots = dirs->num_roots,
+    .num_dirs = dirs->count,
+    .num_entries = apps->count
+  };
+  memcpy(header.magic, drun_cache_magic, sizeof(header.magic));
+  cache_buffer_append(&buffer, &header, sizeof(header));
+
+  const size_t dir_table = buffer.len;
+  for (size_t i = 0; i < dirs->count; i++) {
+    struct drun_cache_dir dir = { 0 };
+    cache_buffer_append(&buffer, &dir, sizeof(dir));
+  }
+  const size_t entry_table = buffer.len;
+  for (size_t i = 0; i < apps->count; i++) {
+    struct drun_cache_entry entry = { 0 };
+    cache_buffer_append(&buffer, &entry, sizeof(entry));
+  }
+
+  header.strings = buffer.len;
+  header.locale = append_string(&buffer, locale);
+  memcpy(buffer.data, &header, sizeof(header));
+
+  for (size_t i = 0; i < dirs->count; i++) {
+    const bool racy = cache_mtime_is_racy(dirs->buf[i].mtime, now);
+    struct drun_cache_dir dir = {
+      .mtime_sec = racy ? -1 : dirs->buf[i].mtime.tv_sec,
+      .mtime_nsec = racy ? -1 : dirs->buf[i].mtime.tv_nsec,
+      .path = append_string(&buffer, dirs->buf[i].path),
+      .exists = dirs->buf[i].exists
+    };
+    memcpy(&buffer.data[dir_table + i * sizeof(dir)], &dir, sizeof(dir));
+  }
+  for (size_t i = 0; i < apps->count; i++) {
+    const struct desktop_entry *app = &apps->buf[i];
+    struct drun_cache_entry entry = {
+      .id = append_string(&buffer, app->id),
+      .path = append_string(&buffer, app->path),
+      .name = append_string(&buffer, app->name),
+      .localized_name = append_string(&buffer, app->localized_name),
+      .generic_name = append_string(&buffer, app->generic_name),
+      .keywords = append_string(&buffer, app->keywords),
+      .exec = append_string(&buffer, app->exec),
+      .icon = append_string(&buffer, app->icon),
+      .no_display = app->no_display
+    };
+    memcpy(&buffer.data[entry_table + i * sizeof(entry)], &entry, sizeof(entry));
+  }
+
+  cache_write(path, &buffer);
+  cache_buffer_destroy(&buffer);
+}
+
+/*
+ * Load the applications from every desktop file in the XDG data directories,
+ * sorted by name.
+ *
+ * Parsing them all is slow enough to notice, so what we need from them is
+ * cached along with the mtimes of the directories they're in, and they're
+ * only parsed again when one of those changes, e.g. after installing or
+ * removing a package, or was changed just before they were parsed.
+ */
+struct desktop_vec drun_load(void)
+{
+  log_enter_context("drun_load");
+  struct desktop_vec apps = desktop_vec_create();
+  struct app_dirs dirs = find_roots();
+  const char *locale = setlocale(LC_MESSAGES, NULL);
+  if (locale == NULL) {
+    locale = "C";
+  }
+
+  char *cache_file = cache_path("drun");
+  if (cache_file != NULL
+      && cache_map(&apps.cache, cache_file)
+      && load_cache(&apps, &dirs, locale)) {
+    log_debug("loaded %zu applications from the cache", apps.count);
+  } else {
+    log_debug("parsing desktop files");
+    cache_unmap(&apps.cache);
+    scan(&apps, &dirs, locale);
+    if (cache_file != NULL) {
+      struct timespec now;
+      clock_gettime(CLOCK_REALTIME, &now);
+      write_cache(cache_file, &apps, &dirs, locale, now);
+    }
+    log_debug("found %zu applications", apps.count);
+  }
+
+  free(cache_file);
+  app_dirs_destroy(&dirs);
+  log_leave_context();
+  return apps;
+}
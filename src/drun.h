@@ -0,0 +1,8 @@
+#ifndef DRUN_H
+#define DRUN_H
+
+#include "desktop_vec.h"
+
+struct desktop_vec drun_load(void);
+
+#endif /* DRUN_H */
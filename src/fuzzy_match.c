@@ -4,24 +4,45 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "candidate.h"
 #include "fuzzy_match.h"
+#include "prefilter.h"
 #include "unicode.h"
 #include "xmalloc.h"
 
 #undef MAX
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
-static int32_t compute_score(
-		int32_t jump,
-		bool first_char,
-		const char *restrict match);
+/*
+ * Patterns up to this many characters are matched using only stack memory.
+ * Anything longer has probably been pasted in, so a malloc won't hurt.
+ */
+#define FUZZY_MATCH_STACK_PATTERN 64
+
+static int32_t compute_score(int32_t jump, bool first_char, uint8_t boundary);
+
+static int32_t fuzzy_match_candidate(
+		const struct fuzzy_term *restrict term,
+		const struct candidate *restrict candidate);
+
+static uint8_t match_boundary(
+		const char *str,
+		const char *match,
+		const struct candidate *candidate);
 
-static int32_t fuzzy_match_recurse(
-		const char *restrict pattern,
+static int32_t fuzzy_match_dp(
+		const uint32_t *restrict chars,
+		size_t plen,
 		const char *restrict str,
-		int32_t score,
-		bool first_match_only,
-		bool first_char);
+		size_t length,
+		const struct candidate *restrict candidate);
+
+static size_t fuzzy_match_alignment(
+		const struct fuzzy_term *restrict term,
+		const struct candidate *restrict candidate,
+		uint32_t *restrict positions);
+
+static size_t sort_positions(uint32_t *positions, size_t count);
 
 /*
  * Split patterns into words, and perform simple matching against str for each.
@@ -73,6 +94,185 @@ int32_t fuzzy_match_words(const char *restrict patterns, const char *restrict st
 	return score;
 }
 
+/*
+ * Prepare patterns for matching against many candidates.
+ *
+ * This does all the per-keypress work of splitting patterns into words,
+ * normalising and folding them as fuzzy_match_words() does and decoding their
+ * characters, so that none of it has to be repeated per candidate.
+ */
+struct fuzzy_query fuzzy_query_create(const char *patterns)
+{
+	char *tmp = utf8_normalize(patterns);
+	struct fuzzy_query query = {
+		.folded = utf8_fold(tmp, strlen(tmp), NULL)
+	};
+	free(tmp);
+
+	/*
+	 * There can be at most as many words or characters as bytes, so
+	 * allocate for that rather than counting twice.
+	 */
+	const size_t size = strlen(query.folded);
+	query.signature = prefilter_signature(query.folded, size);
+	query.terms = xcalloc(size / 2 + 1, sizeof(*query.terms));
+	query.chars = xcalloc(size + 1, sizeof(*query.chars));
+
+	uint32_t *chars = query.chars;
+	char *saveptr = NULL;
+	char *pattern = strtok_r(query.folded, " ", &saveptr);
+	while (pattern != NULL) {
+		struct fuzzy_term *term = &query.terms[query.count];
+		term->folded = pattern;
+		term->length = strlen(pattern);
+		term->chars = chars;
+		for (const char *c = pattern; *c != '\0'; c = utf8_next_char(c)) {
+			chars[term->plen++] = utf8_to_utf32(c);
+		}
+		chars += term->plen;
+		query.plen += term->plen;
+		query.count++;
+		pattern = strtok_r(NULL, " ", &saveptr);
+	}
+
+	return query;
+}
+
+void fuzzy_query_destroy(struct fuzzy_query *query)
+{
+	free(query->folded);
+	free(query->terms);
+	free(query->chars);
+	query->folded = NULL;
+	query->terms = NULL;
+	query->chars = NULL;
+	query->count = 0;
+}
+
+/*
+ * As fuzzy_match_simple_words(), but for a prepared query and candidate.
+ * Distances are still measured in the original string.
+ */
+int32_t fuzzy_match_query_simple_words(
+		const struct fuzzy_query *restrict query,
+		const struct candidate *restrict candidate)
+{
+	int32_t score = 0;
+	for (size_t i = 0; i < query->count; i++) {
+		const struct fuzzy_term *term = &query->terms[i];
+		const char *c = memmem(
+				candidate->folded,
+				candidate->folded_length,
+				term->folded,
+				term->length);
+		if (c == NULL) {
+			return INT32_MIN;
+		}
+		score -= candidate_offset(candidate, c - candidate->folded);
+	}
+	return score;
+}
+
+/*
+ * As fuzzy_match_words(), but for a prepared query and candidate.
+ */
+int32_t fuzzy_match_query_words(
+		const struct fuzzy_query *restrict query,
+		const struct candidate *restrict candidate)
+{
+	int32_t score = 0;
+	for (size_t i = 0; i < query->count; i++) {
+		int32_t word_score = fuzzy_match_candidate(&query->terms[i], candidate);
+		if (word_score == INT32_MIN) {
+			return INT32_MIN;
+		}
+		score += word_score;
+	}
+	return score;
+}
+
+/*
+ * Find which characters of a candidate were matched by
+ * fuzzy_match_query_simple_words().
+ *
+ * The byte offsets into candidate->string of each matched character are
+ * written to positions, which must have room for query->plen entries, in
+ * increasing order and without duplicates. Returns the number written, or 0
+ * if the candidate doesn't match.
+ */
+size_t fuzzy_match_query_simple_positions(
+		const struct fuzzy_query *restrict query,
+		const struct candidate *restrict candidate,
+		uint32_t *restrict positions)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < query->count; i++) {
+		const struct fuzzy_term *term = &query->terms[i];
+		const char *c = memmem(
+				candidate->folded,
+				candidate->folded_length,
+				term->folded,
+				term->length);
+		if (c == NULL) {
+			return 0;
+		}
+		for (size_t j = 0; j < term->plen; j++) {
+			positions[count++] = candidate_offset(candidate, c - candidate->folded);
+			c = utf8_next_char(c);
+		}
+	}
+	return sort_positions(positions, count);
+}
+
+/*
+ * As fuzzy_match_query_simple_positions(), but for the best scoring
+ * alignment found by fuzzy_match_query_words().
+ *
+ * Scoring doesn't keep track of the alignment it settles on, as that would
+ * slow down the search of every candidate. Instead, this repeats the search
+ * for a single candidate and works back from the best score, so it should
+ * only be called for the few that are actually displayed.
+ */
+size_t fuzzy_match_query_positions(
+		const struct fuzzy_query *restrict query,
+		const struct candidate *restrict candidate,
+		uint32_t *restrict positions)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < query->count; i++) {
+		const struct fuzzy_term *term = &query->terms[i];
+		size_t n = fuzzy_match_alignment(term, candidate, &positions[count]);
+		if (n == 0) {
+			return 0;
+		}
+		count += n;
+	}
+	return sort_positions(positions, count);
+}
+
+static int compare_positions(const void *a, const void *b)
+{
+	const uint32_t pa = *(const uint32_t *)a;
+	const uint32_t pb = *(const uint32_t *)b;
+	return (pa > pb) - (pa < pb);
+}
+
+/* Sort positions and remove duplicates, returning the new count. */
+size_t sort_positions(uint32_t *positions, size_t count)
+{
+	if (count == 0) {
+		return 0;
+	}
+	qsort(positions, count, sizeof(*positions), compare_positions);
+	size_t n = 1;
+	for (size_t i = 1; i < count; i++) {
+		if (positions[i] != positions[n - 1]) {
+			positions[n++] = positions[i];
+		}
+	}
+	return n;
+}
+
 /*
  * Returns score if each character in pattern is found sequentially within str.
  * Returns INT32_MIN otherwise.
@@ -94,91 +294,284 @@ int32_t fuzzy_match(const char *restrict pattern, const char *restrict str)
 	/* We can already penalise any unused letters. */
 	score += unmatched_letter_penalty * (int32_t)(slen - plen);
 
-        /*
-         * If the string is more than 100 characters, just find the first fuzzy
-         * match rather than the best.
-         *
-         * This is required as the number of possible matches (for patterns and
-         * strings all consisting of one letter) scales something like:
-         *
-         * slen! / (plen! (slen - plen)!)  ~  slen^plen for plen << slen
-         *
-         * This quickly grinds everything to a halt. 100 is chosen fairly
-         * arbitrarily from the following logic:
-         *
-         * - e is the most common character in English, at around 13% of
-         *   letters. Depending on the context, let's say this be up to 20%.
-         * - 100 * 0.20 = 20 repeats of the same character.
-         * - In the worst case here, 20! / (10! 10!) ~200,000 possible matches,
-         *   which is "slow but not frozen" for my machine.
-         *
-         * In reality, this worst case shouldn't be hit, and finding the "best"
-         * fuzzy match in lines of text > 100 characters isn't really in scope
-         * for a dmenu clone.
-         */
-        bool first_match_only = slen > 100;
+	/* Initialised only because gcc can't tell that plen > 0 here. */
+	uint32_t stack_chars[FUZZY_MATCH_STACK_PATTERN] = { 0 };
+	uint32_t *chars = stack_chars;
+	if (plen > FUZZY_MATCH_STACK_PATTERN) {
+		chars = xmalloc(plen * sizeof(*chars));
+	}
+	for (size_t i = 0; i < plen; i++) {
+		chars[i] = utf32_tolower(utf8_to_utf32(pattern));
+		pattern = utf8_next_char(pattern);
+	}
 
 	/* Perform the match. */
-	score = fuzzy_match_recurse(pattern, str, score, first_match_only, true);
+	int32_t best_score = fuzzy_match_dp(chars, plen, str, strlen(str), NULL);
 
-	return score;
+	if (chars != stack_chars) {
+		free(chars);
+	}
+
+	if (best_score == INT32_MIN) {
+		return INT32_MIN;
+	}
+	return score + best_score;
 }
 
 /*
- * Recursively match the whole of pattern against str.
- * The score parameter is the score of the previously matched character.
+ * As fuzzy_match(), but for a single prepared term against a prepared
+ * candidate.
+ */
+int32_t fuzzy_match_candidate(
+		const struct fuzzy_term *restrict term,
+		const struct candidate *restrict candidate)
+{
+	const int unmatched_letter_penalty = -1;
+	int32_t score = 0;
+
+	if (term->plen == 0) {
+		return score;
+	}
+	if (candidate->folded_chars < term->plen) {
+		return INT32_MIN;
+	}
+
+	/* We can already penalise any unused letters. */
+	score += unmatched_letter_penalty * (int32_t)(candidate->folded_chars - term->plen);
+
+	/* Perform the match. */
+	int32_t best_score = fuzzy_match_dp(
+			term->chars,
+			term->plen,
+			candidate->folded,
+			candidate->folded_length,
+			candidate);
+	if (best_score == INT32_MIN) {
+		return INT32_MIN;
+	}
+	return score + best_score;
+}
+
+/*
+ * The candidate_boundary() of the character at match in str, which is
+ * candidate's folded string if it's given.
+ */
+static uint8_t match_boundary(
+		const char *str,
+		const char *match,
+		const struct candidate *candidate)
+{
+	if (candidate == NULL) {
+		return candidate_boundary(str, match);
+	}
+	const char *original = candidate->string;
+	return candidate_boundary(
+			original,
+			original + candidate_offset(candidate, match - str));
+}
+
+/*
+ * Find the best scoring alignment of pattern against the first length bytes
+ * of str.
+ *
+ * This used to be done by recursing on every occurrence of every pattern
+ * character, which scales something like slen^plen and so had to give up and
+ * take the first match for long strings. Instead, note that the score of a
+ * matched character only depends on whether it's the first pattern character,
+ * whether it's adjacent to the previous match and on its neighbour in str.
+ * That means we only need to remember, for each pattern character, the best
+ * score of a match ending at the previous character of str (for the adjacency
+ * bonus) and the best score ending anywhere before that, giving a
+ * O(plen * slen) dynamic program with O(plen) memory.
  *
- * This reaches a maximum recursion depth of strlen(pattern) + 1. However, the
- * stack usage is small (the maximum I've seen on x86_64 is 144 bytes with
- * gcc -O3), so this shouldn't matter unless pattern contains thousands of
- * characters.
+ * The result is exactly the maximum sum of compute_score() over all possible
+ * alignments, i.e. what the old exhaustive search returned.
  */
-int32_t fuzzy_match_recurse(
-		const char *restrict pattern,
+int32_t fuzzy_match_dp(
+		const uint32_t *restrict chars,
+		size_t plen,
 		const char *restrict str,
-		int32_t score,
-		bool first_match_only,
-		bool first_char)
+		size_t length,
+		const struct candidate *restrict candidate)
 {
-	if (*pattern == '\0') {
-		/* We've matched the full pattern. */
-		return score;
+	int32_t stack_last[FUZZY_MATCH_STACK_PATTERN];
+	int32_t stack_gap[FUZZY_MATCH_STACK_PATTERN];
+	int32_t *last = stack_last;
+	int32_t *gap = stack_gap;
+
+	if (plen > FUZZY_MATCH_STACK_PATTERN) {
+		last = xmalloc(plen * sizeof(*last));
+		gap = xmalloc(plen * sizeof(*gap));
+	}
+
+	/*
+	 * last[i] is the best score with pattern character i matched at the
+	 * previous character of str, gap[i] the best score with it matched
+	 * anywhere before that.
+	 */
+	for (size_t i = 0; i < plen; i++) {
+		last[i] = INT32_MIN;
+		gap[i] = INT32_MIN;
 	}
 
-	const char *match = str;
-	uint32_t search = utf8_to_utf32(pattern);
+	/*
+	 * If we've been given a candidate, str is its folded string, and
+	 * boundaries are those of the corresponding characters of the
+	 * original. Otherwise, str is the original and we fold as we go.
+	 * Either way, a character is only classified once it's matched.
+	 */
+	int32_t jump = 0;
+	for (const char *match = str; match < str + length; match = utf8_next_char(match), jump++) {
+		uint32_t c = utf8_to_utf32(match);
+		if (candidate == NULL) {
+			c = utf32_tolower(c);
+		}
+		int boundary = -1;
+		int32_t adjacent_score = INT32_MIN;
+		int32_t gap_score = INT32_MIN;
 
-	int32_t best_score = INT32_MIN;
+		/*
+		 * Walk the pattern backwards, so that last[i - 1] and
+		 * gap[i - 1] still refer to the previous character of str.
+		 */
+		for (size_t i = plen; i-- > 0;) {
+			int32_t cur = INT32_MIN;
+			if (chars[i] == c) {
+				if (boundary < 0) {
+					boundary = match_boundary(str, match, candidate);
+				}
+				if (i == 0) {
+					cur = compute_score(jump, true, boundary);
+				} else if (last[i - 1] != INT32_MIN || gap[i - 1] != INT32_MIN) {
+					if (adjacent_score == INT32_MIN) {
+						adjacent_score = compute_score(0, false, boundary);
+						gap_score = compute_score(1, false, boundary);
+					}
+					if (last[i - 1] != INT32_MIN) {
+						cur = last[i - 1] + adjacent_score;
+					}
+					if (gap[i - 1] != INT32_MIN) {
+						cur = MAX(cur, gap[i - 1] + gap_score);
+					}
+				}
+			}
+			gap[i] = MAX(gap[i], last[i]);
+			last[i] = cur;
+		}
+	}
+
+	int32_t best_score = MAX(gap[plen - 1], last[plen - 1]);
+
+	if (last != stack_last) {
+		free(last);
+		free(gap);
+	}
+
+	return best_score;
+}
+
+/*
+ * Write the original byte offsets of the characters matched by the best
+ * alignment of term against candidate to positions, returning how many
+ * there were (term->plen), or 0 if there's no match.
+ *
+ * This is the same dynamic program as fuzzy_match_dp(), but keeping the
+ * whole score table so that we can trace back through it.
+ */
+size_t fuzzy_match_alignment(
+		const struct fuzzy_term *restrict term,
+		const struct candidate *restrict candidate,
+		uint32_t *restrict positions)
+{
+	const size_t plen = term->plen;
+	const size_t slen = candidate->folded_chars;
+	if (plen == 0 || slen < plen) {
+		return 0;
+	}
+
+	const char *original = candidate->string;
+	uint32_t *chars = xmalloc(slen * sizeof(*chars));
+	const char **match = xmalloc(slen * sizeof(*match));
+	uint8_t *boundaries = xmalloc(slen * sizeof(*boundaries));
+	int32_t *table = xmalloc(plen * slen * sizeof(*table));
+
+	const char *c = candidate->folded;
+	for (size_t j = 0; j < slen; j++) {
+		chars[j] = utf8_to_utf32(c);
+		match[j] = original + candidate_offset(candidate, c - candidate->folded);
+		boundaries[j] = candidate_boundary(original, match[j]);
+		c = utf8_next_char(c);
+	}
 
 	/*
-	 * Find all occurrences of the next pattern character in str, and
-	 * recurse on them.
+	 * table[i * slen + j] is the best score with pattern character i
+	 * matched at character j.
 	 */
-	while ((match = utf8_strcasechr(match, search)) != NULL) {
-		int32_t jump = 0;
-		for (const char *tmp = str; tmp != match; tmp = utf8_next_char(tmp)) {
-			jump++;
+	for (size_t j = 0; j < slen; j++) {
+		table[j] = INT32_MIN;
+		if (chars[j] == term->chars[0]) {
+			table[j] = compute_score(j, true, boundaries[j]);
 		}
-		int32_t subscore = fuzzy_match_recurse(
-				utf8_next_char(pattern),
-				utf8_next_char(match),
-				compute_score(jump, first_char, match),
-				first_match_only,
-				false);
-		best_score = MAX(best_score, subscore);
-		match = utf8_next_char(match);
-
-		if (first_match_only) {
-			break;
+	}
+	for (size_t i = 1; i < plen; i++) {
+		const int32_t *prev = &table[(i - 1) * slen];
+		int32_t *row = &table[i * slen];
+		int32_t best_gap = INT32_MIN;
+		row[0] = INT32_MIN;
+		for (size_t j = 1; j < slen; j++) {
+			row[j] = INT32_MIN;
+			if (j >= 2) {
+				best_gap = MAX(best_gap, prev[j - 2]);
+			}
+			if (chars[j] != term->chars[i]) {
+				continue;
+			}
+			if (prev[j - 1] != INT32_MIN) {
+				row[j] = prev[j - 1] + compute_score(0, false, boundaries[j]);
+			}
+			if (best_gap != INT32_MIN) {
+				row[j] = MAX(row[j], best_gap + compute_score(1, false, boundaries[j]));
+			}
 		}
 	}
 
-	if (best_score == INT32_MIN) {
-		/* We couldn't match the rest of the pattern. */
-		return INT32_MIN;
-	} else {
-		return score + best_score;
+	/* Find the best place to end, then work backwards from there. */
+	const int32_t *last = &table[(plen - 1) * slen];
+	size_t j = slen;
+	for (size_t k = 0; k < slen; k++) {
+		if (last[k] != INT32_MIN && (j == slen || last[k] > last[j])) {
+			j = k;
+		}
 	}
+
+	size_t count = 0;
+	if (j < slen) {
+		count = plen;
+		for (size_t i = plen - 1; i > 0; i--) {
+			positions[i] = match[j] - original;
+			const int32_t *prev = &table[(i - 1) * slen];
+			const int32_t score = table[i * slen + j];
+			/* Only the first row has matches at j == 0, so j - 1 is in range. */
+			if (prev[j - 1] != INT32_MIN
+					&& prev[j - 1] + compute_score(0, false, boundaries[j]) == score) {
+				j = j - 1;
+				continue;
+			}
+			const int32_t gap_score = compute_score(1, false, boundaries[j]);
+			size_t k = 0;
+			while (prev[k] == INT32_MIN || prev[k] + gap_score != score) {
+				k++;
+			}
+			j = k;
+		}
+		positions[0] = match[j] - original;
+	}
+
+	free(table);
+	free(boundaries);
+	free(match);
+	free(chars);
+	return count;
 }
 
 /*
@@ -196,7 +589,7 @@ int32_t fuzzy_match_recurse(
  *     - If there are letters before the first match.
  *     - If there are superfluous characters in str (already accounted for).
  */
-int32_t compute_score(int32_t jump, bool first_char, const char *restrict match)
+int32_t compute_score(int32_t jump, bool first_char, uint8_t boundary)
 {
 	const int adjacency_bonus = 15;
 	const int separator_bonus = 30;
@@ -208,20 +601,15 @@ int32_t compute_score(int32_t jump, bool first_char, const char *restrict match)
 
 	int32_t score = 0;
 
-	const uint32_t cur = utf8_to_utf32(match);
-
 	/* Apply bonuses. */
 	if (!first_char && jump == 0) {
 		score += adjacency_bonus;
 	}
-	if (!first_char || jump > 0) {
-		const uint32_t prev = utf8_to_utf32(utf8_prev_char(match));
-		if (utf32_isupper(cur) && utf32_islower(prev)) {
-			score += camel_bonus;
-		}
-		if (utf32_isalnum(cur) && !utf32_isalnum(prev)) {
-			score += separator_bonus;
-		}
+	if (boundary & CANDIDATE_BOUNDARY_CAMEL) {
+		score += camel_bonus;
+	}
+	if (boundary & CANDIDATE_BOUNDARY_SEPARATOR) {
+		score += separator_bonus;
 	}
 	if (first_char && jump == 0) {
 		/* Match at start of string gets separator bonus. */
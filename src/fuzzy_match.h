@@ -1,10 +1,52 @@
 #ifndef FUZZY_MATCH_H
 #define FUZZY_MATCH_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "candidate.h"
+
+/* A single, space-separated word of a query. */
+struct fuzzy_term {
+	const char *folded;
+	size_t length;
+	uint32_t *chars;
+	size_t plen;
+};
+
+/*
+ * A query that's been prepared once per keypress, to be matched against
+ * every candidate.
+ */
+struct fuzzy_query {
+	/* Candidates must contain these prefilter signature bits to match. */
+	uint64_t signature;
+	char *folded;
+	uint32_t *chars;
+	struct fuzzy_term *terms;
+	size_t count;
+	/* The total number of characters in all terms. */
+	size_t plen;
+};
 
 int32_t fuzzy_match_simple_words(const char *restrict patterns, const char *restrict str);
 int32_t fuzzy_match_words(const char *restrict patterns, const char *restrict str);
 int32_t fuzzy_match(const char *restrict pattern, const char *restrict str);
 
+struct fuzzy_query fuzzy_query_create(const char *patterns);
+void fuzzy_query_destroy(struct fuzzy_query *query);
+int32_t fuzzy_match_query_simple_words(
+		const struct fuzzy_query *restrict query,
+		const struct candidate *restrict candidate);
+int32_t fuzzy_match_query_words(
+		const struct fuzzy_query *restrict query,
+		const struct candidate *restrict candidate);
+size_t fuzzy_match_query_simple_positions(
+		const struct fuzzy_query *restrict query,
+		const struct candidate *restrict candidate,
+		uint32_t *restrict positions);
+size_t fuzzy_match_query_positions(
+		const struct fuzzy_query *restrict query,
+		const struct candidate *restrict candidate,
+		uint32_t *restrict positions);
+
 #endif /* FUZZY_MATCH_H */
@@ -0,0 +1,34 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static inline uint64_t hash_mix(uint64_t k)
+{
+  k *= UINT64_C(0xbf58476d1ce4e5b9);
+  return k ^ (k >> 31);
+}
+
+/*
+ * A quick non-cryptographic hash, a word at a time. Inputs are never
+ * adversarial enough for anything stronger to be worth it.
+ */
+static inline uint64_t hash_string(const char *s, size_t length)
+{
+  uint64_t h = UINT64_C(0x9e3779b97f4a7c15) ^ length;
+  while (length >= 8) {
+    uint64_t k;
+    memcpy(&k, s, 8);
+    h = (h ^ hash_mix(k)) * UINT64_C(0x94d049bb133111eb);
+    s += 8;
+    length -= 8;
+  }
+  uint64_t k = 0;
+  memcpy(&k, s, length);
+  h = (h ^ hash_mix(k)) * UINT64_C(0x94d049bb133111eb);
+  return h ^ (h >> 32);
+}
+
+#endif /* HASH_H */
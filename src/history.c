@@ -0,0 +1,431 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+#include "hash.h"
+#include "history.h"
+#include "log.h"
+#include "xmalloc.h"
+
+/* Entries that have decayed to less than this are dropped on compaction. */
+#define HISTORY_MIN_FRECENCY (1.0 / 1024)
+
+#define HISTORY_MIN_SLOTS 256
+
+/* How much each doubling of frecency adds to the weight. */
+#define HISTORY_WEIGHT_SCALE 20
+
+/*
+ * Scores grow by a factor of two every half-life, so the epoch has to be
+ * moved up now and then to keep them from overflowing.
+ */
+#define HISTORY_MAX_HALF_LIVES 512
+
+static const char history_magic[16] = "bread-history-1";
+
+static_assert(sizeof(struct history_header) == 64, "history header size");
+static_assert(sizeof(struct history_record) == 256, "history record size");
+
+/*
+ * Return the path of the history file called name, or NULL if there's
+ * nowhere to put it.
+ */
+char *history_path(const char *name)
+{
+  const char *base = getenv("XDG_STATE_HOME");
+  const char *suffix = "";
+  if (base == NULL || base[0] == '\0') {
+    base = getenv("HOME");
+    suffix = "/.local/state";
+    if (base == NULL) {
+      return NULL;
+    }
+  }
+  size_t len = strlen(base) + strlen(suffix) + strlen("/bread/") + strlen(name) + 1;
+  char *path = xmalloc(len);
+  snprintf(path, len, "%s%s/bread/%s", base, suffix, name);
+  return path;
+}
+
+static uint64_t record_hash(const char *string, size_t length)
+{
+  uint64_t h = hash_string(string, length);
+  return h == 0 ? 1 : h;
+}
+
+/*
+ * Find the record for string, or the empty one it would go in, or NULL if
+ * it isn't there and there's no room.
+ */
+static struct history_record *find(
+    struct history_record *records,
+    size_t num_slots,
+    const char *string,
+    size_t length,
+    uint64_t h)
+{
+  const size_t mask = num_slots - 1;
+  const size_t prefix = length < HISTORY_STRING_MAX ? length : HISTORY_STRING_MAX;
+  size_t i = h & mask;
+  for (size_t probes = 0; probes < num_slots; probes++, i = (i + 1) & mask) {
+    struct history_record *record = &records[i];
+    if (record->hash == 0) {
+      return record;
+    }
+    if (record->hash == h
+        && record->length == length
+        && !memcmp(record->string, string, prefix)) {
+      return record;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Map the history file at history->path, checking it's one of ours. It's
+ * only mapped writable when it's about to be written to.
+ */
+static bool map(struct history *history, bool writable)
+{
+  int fd = open(history->path, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct history_header)) {
+    close(fd);
+    return false;
+  }
+  const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void *data = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  const struct history_header *header = data;
+  const uint64_t num_slots = header->num_slots;
+  if (memcmp(header->magic, history_magic, sizeof(header->magic))
+      || num_slots == 0
+      || (num_slots & (num_slots - 1)) != 0
+      || num_slots > SIZE_MAX / sizeof(struct history_record)
+      || sizeof(*header) + num_slots * sizeof(struct history_record) != (size_t)st.st_size) {
+    munmap(data, st.st_size);
+    return false;
+  }
+
+  history->header = data;
+  history->records = (struct history_record *)&history->header[1];
+  history->size = st.st_size;
+  history->dev = st.st_dev;
+  history->ino = st.st_ino;
+  history->writable = writable;
+  return true;
+}
+
+static void unmap(struct history *history)
+{
+  if (history->header != NULL) {
+    munmap(history->header, history->size);
+  }
+  history->header = NULL;
+  history->records = NULL;
+  history->size = 0;
+}
+
+/*
+ * Take an exclusive lock on the history file at path, so that other instances
+ * leave it alone until the returned fd is closed. Returns -1 if there's no
+ * file to lock.
+ *
+ * Compaction replaces the file, which whoever held the lock may have done
+ * while we waited, in which case it's the new file that needs locking.
+ */
+static int lock(const char *path)
+{
+  for (;;) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      return -1;
+    }
+    struct stat locked;
+    struct stat current;
+    if (flock(fd, LOCK_EX) == -1 || fstat(fd, &locked) == -1) {
+      close(fd);
+      return -1;
+    }
+    if (stat(path, &current) == 0
+        && current.st_dev == locked.st_dev
+        && current.st_ino == locked.st_ino) {
+      return fd;
+    }
+    close(fd);
+  }
+}
+
+/*
+ * As lock(), mapping the history file afresh, and writable, if it isn't
+ * already or another instance has replaced it since it was mapped.
+ */
+static int lock_mapped(struct history *history)
+{
+  const int fd = lock(history->path);
+  if (fd == -1) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return -1;
+  }
+  if (!history->writable
+      || st.st_dev != history->dev
+      || st.st_ino != history->ino) {
+    unmap(history);
+    if (!map(history, true)) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+/*
+ * Rewrite the history file with room for extra more entries than it holds,
+ * dropping any that have all but decayed away and rebasing the scores of
+ * the rest on now. The entries are counted afresh from the slots, which
+ * puts right a count left short by a crash part way through history_use().
+ *
+ * It's written to a temporary file and renamed into place, so a crash
+ * part way through leaves the old one as it was. The old one should be
+ * locked, if there is one, so that nothing's lost from it.
+ */
+static bool compact(struct history *history, size_t extra, int64_t now)
+{
+  log_enter_context("history_compact");
+  const struct history_header *old = history->header;
+  const size_t old_slots = old != NULL ? old->num_slots : 0;
+  const double decay = old != NULL
+    ? exp2((old->epoch - now) / HISTORY_HALF_LIFE)
+    : 1;
+
+  size_t count = 0;
+  for (size_t i = 0; i < old_slots; i++) {
+    const struct history_record *record = &history->records[i];
+    count += record->hash != 0 && record->score * decay >= HISTORY_MIN_FRECENCY;
+  }
+  count += extra;
+  size_t num_slots = HISTORY_MIN_SLOTS;
+  while (2 * (count + 1) > num_slots) {
+    num_slots *= 2;
+  }
+
+  struct history_header header = {
+    .num_slots = num_slots,
+    .epoch = now
+  };
+  memcpy(header.magic, history_magic, sizeof(header.magic));
+  struct history_record *records = xcalloc(num_slots, sizeof(*records));
+  for (size_t i = 0; i < old_slots; i++) {
+    const struct history_record *record = &history->records[i];
+    const double score = record->score * decay;
+    if (record->hash == 0 || score < HISTORY_MIN_FRECENCY) {
+      continue;
+    }
+    struct history_record *slot = find(
+        records,
+        num_slots,
+        record->string,
+        record->length,
+        record->hash);
+    *slot = *record;
+    slot->score = score;
+    header.count++;
+  }
+
+  struct cache_buffer buffer = { 0 };
+  cache_buffer_append(&buffer, &header, sizeof(header));
+  cache_buffer_append(&buffer, records, num_slots * sizeof(*records));
+  free(records);
+  bool ok = cache_write(history->path, &buffer);
+  cache_buffer_destroy(&buffer);
+
+  unmap(history);
+  ok = ok && map(history, false);
+  log_debug("%zu entries in %zu slots", (size_t)header.count, num_slots);
+  log_leave_context();
+  return ok;
+}
+
+/*
+ * Open the history file at path, creating it if need be. Returns false if
+ * that isn't possible, in which case there's no history to go on.
+ */
+bool history_open(struct history *history, const char *path)
+{
+  *history = (struct history){ .path = xstrdup(path) };
+  if (map(history, false)) {
+    return true;
+  }
+
+  /* Another instance may be in the middle of replacing it. */
+  const int fd = lock(path);
+  if (fd != -1 && map(history, false)) {
+    close(fd);
+    return true;
+  }
+  if (fd != -1) {
+    log_warning("History file %s is corrupt, starting afresh.\n", path);
+  }
+  const bool ok = compact(history, 0, time(NULL));
+  if (fd != -1) {
+    close(fd);
+  }
+  if (!ok) {
+    history_close(history);
+    return false;
+  }
+  return true;
+}
+
+void history_close(struct history *history)
+{
+  unmap(history);
+  free(history->path);
+  history->path = NULL;
+}
+
+/*
+ * How many times string has been chosen, with each choice counting for
+ * half as much every HISTORY_HALF_LIFE since it was made.
+ */
+double history_frecency(
+    const struct history *history,
+    const char *string,
+    size_t length,
+    int64_t now)
+{
+  if (history->header == NULL) {
+    return 0;
+  }
+  const struct history_record *record = find(
+      history->records,
+      history->header->num_slots,
+      string,
+      length,
+      record_hash(string, length));
+  if (record == NULL || record->hash == 0) {
+    return 0;
+  }
+  return record->score * exp2((history->header->epoch - now) / HISTORY_HALF_LIFE);
+}
+
+/*
+ * How much history should add to the score of string, from 0 to
+ * HISTORY_WEIGHT_MAX. Each doubling of its frecency counts the same, so that
+ * a handful of recent uses is enough to stand out.
+ */
+int32_t history_weight(
+    const struct history *history,
+    const char *string,
+    size_t length,
+    int64_t now)
+{
+  const double frecency = history_frecency(history, string, length, now);
+  const double weight = HISTORY_WEIGHT_SCALE * log2(1 + frecency);
+  return weight < HISTORY_WEIGHT_MAX ? (int32_t)weight : HISTORY_WEIGHT_MAX;
+}
+
+/* Make sure the changes to the len bytes at addr are written out. */
+static void sync_range(const void *addr, size_t len)
+{
+  const uintptr_t page = sysconf(_SC_PAGESIZE);
+  const uintptr_t start = (uintptr_t)addr & ~(page - 1);
+  msync((void *)start, (uintptr_t)addr + len - start, MS_SYNC);
+}
+
+/*
+ * Record that string has just been chosen.
+ *
+ * This only touches its own record and the header, except when the table
+ * needs to grow or the scores need rebasing. The file is locked throughout,
+ * so that other instances choosing at the same time don't lose each other's
+ * changes.
+ */
+void history_use(
+    struct history *history,
+    const char *string,
+    size_t length,
+    int64_t now)
+{
+  if (history->header == NULL) {
+    return;
+  }
+  int fd = lock_mapped(history);
+  if (fd == -1) {
+    return;
+  }
+  const uint64_t h = record_hash(string, length);
+  struct history_record *record = find(
+      history->records,
+      history->header->num_slots,
+      string,
+      length,
+      h);
+
+  /*
+   * The count is only trusted to decide when to compact, which counts the
+   * entries properly, so at worst a wrong one compacts too early.
+   */
+  const bool full = record == NULL
+    || (record->hash == 0
+      && history->header->count >= history->header->num_slots / 2);
+  const bool overflowing = now - history->header->epoch
+    > HISTORY_MAX_HALF_LIVES * HISTORY_HALF_LIFE;
+  if (full || overflowing) {
+    const bool ok = compact(history, 1, now);
+    /* The lock was on the file that's just been replaced. */
+    close(fd);
+    fd = ok ? lock_mapped(history) : -1;
+    if (fd == -1) {
+      return;
+    }
+    record = find(
+        history->records,
+        history->header->num_slots,
+        string,
+        length,
+        h);
+    if (record == NULL) {
+      close(fd);
+      return;
+    }
+  }
+
+  if (record->hash == 0) {
+    record->hash = h;
+    record->length = length;
+    memcpy(
+        record->string,
+        string,
+        length < HISTORY_STRING_MAX ? length : HISTORY_STRING_MAX);
+    history->header->count++;
+    sync_range(history->header, sizeof(*history->header));
+  }
+  record->score += exp2((now - history->header->epoch) / HISTORY_HALF_LIFE);
+  record->last_used = now;
+  record->uses++;
+  sync_range(record, sizeof(*record));
+  close(fd);
+}
@@ -0,0 +1,89 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * How often and how recently each candidate has been chosen.
+ *
+ * The history file is a hash table of fixed-size records, mapped straight
+ * into memory, so that nothing needs parsing on startup and choosing a
+ * candidate only rewrites its own record.
+ */
+
+/* How long it takes for a choice to count half as much, in seconds. */
+#define HISTORY_HALF_LIFE (30.0 * 24 * 60 * 60)
+
+/*
+ * The most history can add to a candidate's score, about what a few well
+ * placed matching characters are worth, so that it breaks near-ties rather
+ * than overriding what was typed.
+ */
+#define HISTORY_WEIGHT_MAX 120
+
+/* Longer strings are only kept in part, and matched by their hash. */
+#define HISTORY_STRING_MAX 224
+
+struct history_header {
+  char magic[16];
+  /* Always a power of two. */
+  uint64_t num_slots;
+  /*
+   * How many slots are in use, though a crash part way through an update can
+   * leave this short, so it's never relied on beyond deciding when to compact.
+   */
+  uint64_t count;
+  /* The time scores are relative to, in seconds since the Unix epoch. */
+  int64_t epoch;
+  uint8_t padding[24];
+};
+
+struct history_record {
+  /* 0 for an empty slot. */
+  uint64_t hash;
+  /*
+   * The sum of 2^((t - epoch) / half-life) for each time t this was chosen,
+   * which only needs adding to each time, unlike a score decayed to now.
+   */
+  double score;
+  int64_t last_used;
+  uint32_t length;
+  uint32_t uses;
+  char string[HISTORY_STRING_MAX];
+};
+
+struct history {
+  char *path;
+  struct history_header *header;
+  struct history_record *records;
+  size_t size;
+  /* Which file is mapped, to tell when another instance has replaced it. */
+  dev_t dev;
+  ino_t ino;
+  /* Whether it's mapped for writing, which only history_use() needs. */
+  bool writable;
+};
+
+char *history_path(const char *name);
+bool history_open(struct history *history, const char *path);
+void history_close(struct history *history);
+double history_frecency(
+    const struct history *history,
+    const char *string,
+    size_t length,
+    int64_t now);
+int32_t history_weight(
+    const struct history *history,
+    const char *string,
+    size_t length,
+    int64_t now);
+void history_use(
+    struct history *history,
+    const char *string,
+    size_t length,
+    int64_t now);
+
+#endif /* HISTORY_H */
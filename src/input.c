@@ -1,6 +1,81 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <xkbcommon/xkbcommon.h>
 #include "input.h"
 #include "symbol.h"
+#include "unicode.h"
 
+static bool delete_char(struct state *state)
+{
+  if (state->query_length == 0) {
+    return false;
+  }
+  const char *end = state->query + state->query_length;
+  state->query_length = utf8_prev_char(end) - state->query;
+  return true;
+}
+
+/* Delete back to the start of the word before the cursor, like a shell. */
+static bool delete_word(struct state *state)
+{
+  if (state->query_length == 0) {
+    return false;
+  }
+  while (state->query_length > 0
+      && state->query[state->query_length - 1] == ' ') {
+    state->query_length--;
+  }
+  while (state->query_length > 0
+      && state->query[state->query_length - 1] != ' ') {
+    state->query_length--;
+  }
+  return true;
+}
+
+static bool insert_char(struct state *state, uint32_t c)
+{
+  char buf[6];
+  const uint8_t length = utf32_to_utf8(c, buf);
+  /* Leave room for the terminator. */
+  if (state->query_length + length >= STATE_QUERY_MAX) {
+    return false;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    state->query[state->query_length++] = buf[i];
+  }
+  return true;
+}
+
+/*
+ * Apply a keypress to the query.
+ *
+ * This only edits the text and marks it dirty. Matching is left until all the
+ * events that have arrived have been handled, so a paste or a burst of typing
+ * costs one pass over the candidates rather than one per key.
+ */
 void input_on_keypress(struct input_handler *handler, struct input *input)
 {
+  struct state *state = handler->state;
+  const xkb_keysym_t sym = input->symbol.xkb_sym;
+  const uint32_t c = input->symbol.unicode_char;
+  bool changed;
+
+  if (sym == XKB_KEY_BackSpace) {
+    changed = input->mod_ctrl ? delete_word(state) : delete_char(state);
+  } else if (input->mod_ctrl && sym == XKB_KEY_w) {
+    changed = delete_word(state);
+  } else if (input->mod_ctrl && sym == XKB_KEY_u) {
+    changed = state->query_length > 0;
+    state->query_length = 0;
+  } else if (!input->mod_ctrl && c != 0 && utf32_isprint(c)) {
+    changed = insert_char(state, c);
+  } else {
+    return;
+  }
+
+  state->query[state->query_length] = '\0';
+  if (changed) {
+    state->query_dirty = true;
+  }
 }
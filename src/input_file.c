@@ -0,0 +1,232 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "candidate.h"
+#include "input_file.h"
+#include "log.h"
+#include "unicode.h"
+
+/* How many newlines to find before handing them over. */
+#define INPUT_FILE_BATCH 4096
+
+typedef size_t (*newline_scan)(
+    const char *restrict data,
+    size_t start,
+    size_t size,
+    size_t *restrict newlines,
+    size_t max);
+
+/*
+ * Each scan writes the offsets of up to max newlines in data from start
+ * onwards to newlines, returning how many it found. Fewer than max means it
+ * reached the end.
+ */
+static size_t scan_scalar(
+    const char *restrict data,
+    size_t start,
+    size_t size,
+    size_t *restrict newlines,
+    size_t max)
+{
+  size_t n = 0;
+  const char *c = &data[start];
+  while (n < max && (c = memchr(c, '\n', &data[size] - c)) != NULL) {
+    newlines[n++] = c - data;
+    c++;
+  }
+  return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+[[gnu::target("sse2")]]
+static size_t scan_sse2(
+    const char *restrict data,
+    size_t start,
+    size_t size,
+    size_t *restrict newlines,
+    size_t max)
+{
+  const __m128i nl = _mm_set1_epi8('\n');
+  size_t n = 0;
+  size_t i = start;
+  for (; i + 16 <= size; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)&data[i]);
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+    while (mask != 0) {
+      if (n == max) {
+        return n;
+      }
+      newlines[n++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+  return n + scan_scalar(data, i, size, &newlines[n], max - n);
+}
+
+[[gnu::target("avx2")]]
+static size_t scan_avx2(
+    const char *restrict data,
+    size_t start,
+    size_t size,
+    size_t *restrict newlines,
+    size_t max)
+{
+  const __m256i nl = _mm256_set1_epi8('\n');
+  size_t n = 0;
+  size_t i = start;
+  for (; i + 32 <= size; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)&data[i]);
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+    while (mask != 0) {
+      if (n == max) {
+        return n;
+      }
+      newlines[n++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+  return n + scan_scalar(data, i, size, &newlines[n], max - n);
+}
+#endif
+
+static newline_scan choose_scan(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) {
+    return scan_avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return scan_sse2;
+  }
+#endif
+  return scan_scalar;
+}
+
+/*
+ * Map the file at path read-only. Returns false, having logged why, if it
+ * can't be.
+ */
+bool input_file_open(struct input_file *file, const char *path)
+{
+  log_enter_context("input_file_open");
+  *file = (struct input_file){ 0 };
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    log_error("Couldn't open %s: %s.\n", path, strerror(errno));
+    log_leave_context();
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    log_error("Couldn't stat %s: %s.\n", path, strerror(errno));
+    close(fd);
+    log_leave_context();
+    return false;
+  }
+
+  /* Empty files can't be mapped, but there's nothing to read anyway. */
+  if (st.st_size > 0) {
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      log_error("Couldn't map %s: %s.\n", path, strerror(errno));
+      close(fd);
+      log_leave_context();
+      return false;
+    }
+    madvise(data, st.st_size, MADV_WILLNEED);
+    file->data = data;
+    file->size = st.st_size;
+  }
+  close(fd);
+
+  log_debug("mapped %zu bytes of %s", file->size, path);
+  log_leave_context();
+  return true;
+}
+
+void input_file_close(struct input_file *file)
+{
+  if (file->data != NULL) {
+    munmap(file->data, file->size);
+  }
+  file->data = NULL;
+  file->size = 0;
+}
+
+/*
+ * Add the line from start to end of data to candidates, checking it's valid
+ * UTF-8 first unless it's already known to be, and skipping it if seen is
+ * given and already has it.
+ */
+static size_t add_line(
+    struct candidate_vec *candidates,
+    struct string_set *seen,
+    const char *data,
+    size_t start,
+    size_t end,
+    bool valid)
+{
+  if (!valid && !utf8_validate(&data[start], end - start)) {
+    log_warning("Skipping a line of invalid UTF-8 input.\n");
+    return 0;
+  }
+  if (seen != NULL && !string_set_add(seen, &data[start], end - start)) {
+    return 0;
+  }
+  candidate_vec_add(candidates, &data[start], end - start);
+  return 1;
+}
+
+/*
+ * Add every line of file to candidates, returning how many were added. If
+ * seen isn't NULL, lines already in it are dropped, and the rest added to it.
+ *
+ * Nothing is copied: candidates (and seen) point into the mapping, so it
+ * must outlive them, and only lines that need folding take up any memory of
+ * their own.
+ */
+size_t input_file_read(
+    const struct input_file *file,
+    struct candidate_vec *candidates,
+    struct string_set *seen)
+{
+  const char *data = file->data;
+  const size_t size = file->size;
+  if (size == 0) {
+    return 0;
+  }
+
+  /*
+   * Checking the whole file is quicker than checking each line, so only
+   * do that if there's something to skip.
+   */
+  const bool valid = utf8_validate(data, size);
+  const newline_scan scan = choose_scan();
+
+  size_t newlines[INPUT_FILE_BATCH];
+  size_t added = 0;
+  size_t start = 0;
+  size_t n;
+  do {
+    n = scan(data, start, size, newlines, INPUT_FILE_BATCH);
+    for (size_t i = 0; i < n; i++) {
+      added += add_line(candidates, seen, data, start, newlines[i], valid);
+      start = newlines[i] + 1;
+    }
+  } while (n == INPUT_FILE_BATCH);
+
+  /* The last line needn't end in a newline. */
+  if (start < size) {
+    added += add_line(candidates, seen, data, start, size, valid);
+  }
+  return added;
+}
@@ -0,0 +1,25 @@
+#ifndef INPUT_FILE_H
+#define INPUT_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "candidate.h"
+#include "string_set.h"
+
+/*
+ * A file of newline-separated candidates, mapped into memory rather than
+ * read, so that candidates can point straight into it.
+ */
+struct input_file {
+  char *data;
+  size_t size;
+};
+
+bool input_file_open(struct input_file *file, const char *path);
+void input_file_close(struct input_file *file);
+size_t input_file_read(
+    const struct input_file *file,
+    struct candidate_vec *candidates,
+    struct string_set *seen);
+
+#endif /* INPUT_FILE_H */
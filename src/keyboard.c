@@ -53,9 +53,8 @@ void keyboard_key_held(struct keyboard *keyboard, uint32_t key)
   log_leave_context();
 }
 
-void keyboard_key_pressed(struct keyboard *keyboard, uint32_t key)
+static struct input keyboard_input(struct keyboard *keyboard, uint32_t key)
 {
-  log_enter_context("keyboard_key_pressed");
   struct input input = {
     .symbol = symbol_create(keyboard->state, key),
     .mod_ctrl = xkb_state_mod_name_is_active(
@@ -63,6 +62,13 @@ void keyboard_key_pressed(struct keyboard *keyboard, uint32_t key)
       XKB_MOD_NAME_CTRL,
       XKB_STATE_MODS_EFFECTIVE),
   };
+  return input;
+}
+
+void keyboard_key_pressed(struct keyboard *keyboard, uint32_t key)
+{
+  log_enter_context("keyboard_key_pressed");
+  struct input input = keyboard_input(keyboard, key);
 
   if (xkb_keymap_key_repeats(keyboard->keymap, input.symbol.keycode)
       && keyboard->repeat.rate != 0) {
@@ -80,6 +86,36 @@ void keyboard_key_pressed(struct keyboard *keyboard, uint32_t key)
   log_leave_context();
 }
 
+/*
+ * Return how many milliseconds until the held key is due to repeat, 0 if it
+ * already is, or -1 if no key is held, for use as a poll() timeout.
+ */
+int keyboard_repeat_timeout(const struct keyboard *keyboard)
+{
+  if (!keyboard->repeat.active) {
+    return -1;
+  }
+  /* The clock wraps every 49 days, so compare the difference. */
+  int32_t wait = (int32_t)(keyboard->repeat.next - gettime_ms());
+  return wait > 0 ? wait : 0;
+}
+
+/*
+ * Repeat the held key if it's due. The compositor only tells us when keys
+ * are pressed and released, so repeating them is up to us.
+ */
+void keyboard_repeat(struct keyboard *keyboard)
+{
+  if (keyboard_repeat_timeout(keyboard) != 0 || keyboard->state == NULL) {
+    return;
+  }
+  log_enter_context("keyboard_repeat");
+  keyboard->repeat.next = gettime_ms() + 1000 / keyboard->repeat.rate;
+  struct input input = keyboard_input(keyboard, keyboard->repeat.keycode - 8);
+  input_on_keypress(&keyboard->input_handler, &input);
+  log_leave_context();
+}
+
 void keyboard_modifiers(
   struct keyboard *keyboard,
   uint32_t serial,
@@ -113,13 +149,16 @@ void keyboard_repeat_info(
   log_enter_context("keyboard_repeat_info");
   keyboard->repeat.rate = rate;
   keyboard->repeat.delay = delay;
+  if (rate == 0) {
+    keyboard->repeat.active = false;
+  }
   log_leave_context();
 }
 
 struct keyboard keyboard_create(struct config *conf)
 {
   log_enter_context("keyboard_create");
-  struct keyboard keyboard;
+  struct keyboard keyboard = { 0 };
   keyboard.context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
   if (keyboard.context == NULL) {
     log_enter_context("keyboard.context is NULL");
@@ -36,6 +36,8 @@ void keyboard_key_held(
 void keyboard_key_pressed(
   struct keyboard *keyboard,
   uint32_t key);
+int keyboard_repeat_timeout(const struct keyboard *keyboard);
+void keyboard_repeat(struct keyboard *keyboard);
 void keyboard_modifiers(
   struct keyboard *keyboard,
   uint32_t serial,
@@ -1,3 +1,4 @@
+#include <getopt.h>
 #include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,6 +8,71 @@
 #include "config.h"
 #include "log.h"
 
+static void usage(FILE *stream, const char *name)
+{
+  fprintf(stream,
+      "Usage: %s [options]\n"
+      "\n"
+      "Reads candidates from stdin, one per line, unless given a file.\n"
+      "\n"
+      "  -h, --help                 Print this message and exit.\n"
+      "      --dedup                Drop repeated candidates, keeping the\n"
+      "                             first of each.\n"
+      "      --input-file <path>    Map candidates from path rather than\n"
+      "                             reading stdin.\n"
+      "      --mode <mode>          Where candidates come from: dmenu (the\n"
+      "                             default) reads them as above, drun lists\n"
+      "                             the applications with desktop files, and\n"
+      "                             run lists the commands in PATH.\n",
+      name);
+}
+
+static void parse_args(struct config *conf, int argc, char *argv[])
+{
+  const struct option long_options[] = {
+    {"dedup", no_argument, NULL, 'd'},
+    {"help", no_argument, NULL, 'h'},
+    {"input-file", required_argument, NULL, 'i'},
+    {"mode", required_argument, NULL, 'm'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+    switch (opt) {
+      case 'd':
+        conf->dedup = true;
+        break;
+      case 'h':
+        usage(stdout, argv[0]);
+        exit(EXIT_SUCCESS);
+      case 'i':
+        conf->input_file = optarg;
+        break;
+      case 'm':
+        if (!strcmp(optarg, "dmenu")) {
+          conf->mode = MODE_DMENU;
+        } else if (!strcmp(optarg, "drun")) {
+          conf->mode = MODE_DRUN;
+        } else if (!strcmp(optarg, "run")) {
+          conf->mode = MODE_RUN;
+        } else {
+          log_error("Unknown mode \"%s\".\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      default:
+        usage(stderr, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+  if (optind < argc) {
+    log_error("Unexpected argument \"%s\".\n", argv[optind]);
+    usage(stderr, argv[0]);
+    exit(EXIT_FAILURE);
+  }
+}
+
 int main(int argc, char *argv[])
 {
   log_enter_context("main");
@@ -14,10 +80,15 @@ int main(int argc, char *argv[])
 
   log_debug("creating config");
   struct config conf = {
-    .font_size = 24
+    .font_size = 24,
+    .num_results = 64
   };
+  parse_args(&conf, argc, argv);
 
-  struct bread bread = bread_create(&conf);
+  struct bread bread;
+  bread_create(&bread, &conf);
+  bread_run(&bread);
+  bread_destroy(&bread);
 
   log_debug("finished execution");
   return 0;
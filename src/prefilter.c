@@ -0,0 +1,130 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "prefilter.h"
+
+/*
+ * Cheap rejection of candidates that can't possibly match.
+ *
+ * Each candidate gets a 64-bit signature of which bytes appear in its folded
+ * string, computed once when it's loaded. Both simple and fuzzy matching need
+ * every character of the query to be present in the candidate, so any
+ * candidate whose signature doesn't contain all the bits of the query's
+ * signature can be skipped without being scored. Most candidates fail to
+ * match, so this turns most of the work per keypress into a linear scan.
+ */
+
+static inline uint8_t signature_bit(unsigned char c)
+{
+  if (c >= 'a' && c <= 'z') {
+    return c - 'a';
+  }
+  if (c >= '0' && c <= '9') {
+    return 26 + c - '0';
+  }
+  if (c < 0x80) {
+    return 36 + c % 12;
+  }
+  /* Bytes of multi-byte characters. */
+  return 48 + c % 16;
+}
+
+uint64_t prefilter_signature(const char *folded, size_t length)
+{
+  uint64_t signature = 0;
+  for (size_t i = 0; i < length; i++) {
+    const unsigned char c = folded[i];
+    if (c != ' ') {
+      signature |= UINT64_C(1) << signature_bit(c);
+    }
+  }
+  return signature;
+}
+
+static size_t scan_scalar(
+    const uint64_t *restrict signatures,
+    size_t start,
+    size_t count,
+    uint64_t signature,
+    uint32_t *restrict survivors,
+    size_t n)
+{
+  for (size_t i = start; i < count; i++) {
+    survivors[n] = i;
+    n += (signatures[i] & signature) == signature;
+  }
+  return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+[[gnu::target("sse2")]]
+static size_t scan_sse2(
+    const uint64_t *restrict signatures,
+    size_t count,
+    uint64_t signature,
+    uint32_t *restrict survivors)
+{
+  const __m128i q = _mm_set1_epi64x(signature);
+  const __m128i zero = _mm_setzero_si128();
+  size_t n = 0;
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    __m128i s = _mm_loadu_si128((const __m128i *)&signatures[i]);
+    /* Missing bits are set in (s & q) ^ q. */
+    __m128i missing = _mm_xor_si128(_mm_and_si128(s, q), q);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(missing, zero));
+    survivors[n] = i;
+    n += (mask & 0x00FF) == 0x00FF;
+    survivors[n] = i + 1;
+    n += (mask & 0xFF00) == 0xFF00;
+  }
+  return scan_scalar(signatures, i, count, signature, survivors, n);
+}
+
+[[gnu::target("avx2")]]
+static size_t scan_avx2(
+    const uint64_t *restrict signatures,
+    size_t count,
+    uint64_t signature,
+    uint32_t *restrict survivors)
+{
+  const __m256i q = _mm256_set1_epi64x(signature);
+  size_t n = 0;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i s = _mm256_loadu_si256((const __m256i *)&signatures[i]);
+    __m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(s, q), q);
+    unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+    while (mask != 0) {
+      survivors[n++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+  return scan_scalar(signatures, i, count, signature, survivors, n);
+}
+#endif
+
+/*
+ * Write the indices of all signatures containing every bit of signature to
+ * survivors, which must have space for count entries, and return how many
+ * there were. Indices are written in increasing order.
+ */
+size_t prefilter_scan(
+    const uint64_t *restrict signatures,
+    size_t count,
+    uint64_t signature,
+    uint32_t *restrict survivors)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) {
+    return scan_avx2(signatures, count, signature, survivors);
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return scan_sse2(signatures, count, signature, survivors);
+  }
+#endif
+  return scan_scalar(signatures, 0, count, signature, survivors, 0);
+}
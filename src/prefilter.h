@@ -0,0 +1,14 @@
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t prefilter_signature(const char *folded, size_t length);
+size_t prefilter_scan(
+    const uint64_t *restrict signatures,
+    size_t count,
+    uint64_t signature,
+    uint32_t *restrict survivors);
+
+#endif /* PREFILTER_H */
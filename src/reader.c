@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "log.h"
+#include "reader.h"
+#include "string_set.h"
+#include "string_vec.h"
+#include "unicode.h"
+#include "xmalloc.h"
+
+#define READER_CHUNK_SIZE (64 << 10)
+
+/*
+ * Most that's read in one go, so that a fast producer can't keep us from
+ * handling input.
+ */
+#define READER_MAX_READ (1 << 20)
+
+/*
+ * Add the line of length bytes at line to strings, unless seen is given and
+ * already has it.
+ */
+static size_t add_line(
+    struct string_vec *strings,
+    struct string_set *seen,
+    char *line,
+    size_t length)
+{
+  line[length] = '\0';
+  if (!utf8_validate(line, length)) {
+    log_warning("Skipping a line of invalid UTF-8 input.\n");
+    return 0;
+  }
+  size_t index = string_vec_add(strings, line, length, 0);
+
+  /*
+   * The set has to refer to the copy, as line is about to be overwritten,
+   * so a duplicate is only found out after it's been added.
+   */
+  if (seen != NULL
+      && !string_set_add(seen, string_vec_get(strings, index), length)) {
+    string_vec_pop(strings);
+    return 0;
+  }
+  return 1;
+}
+
+struct reader reader_create(int fd)
+{
+  log_enter_context("reader_create");
+  struct reader reader = {
+    .fd = fd,
+    .size = READER_CHUNK_SIZE
+  };
+  int flags = fcntl(fd, F_GETFL);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    log_warning("Couldn't make input non-blocking.\n");
+  }
+  reader.buf = xmalloc(reader.size);
+  log_leave_context();
+  return reader;
+}
+
+void reader_destroy(struct reader *reader)
+{
+  free(reader->buf);
+  reader->buf = NULL;
+  reader->size = 0;
+  reader->len = 0;
+}
+
+/*
+ * Read whatever input is available, copying each complete line to strings.
+ * Returns the number of strings added. Sets reader->eof once the input has
+ * been closed, at which point any final unterminated line is added too.
+ *
+ * If seen isn't NULL, lines already in it are dropped, and the rest added
+ * to it.
+ */
+size_t reader_read(
+    struct reader *reader,
+    struct string_vec *strings,
+    struct string_set *seen)
+{
+  size_t added = 0;
+  size_t total = 0;
+  while (!reader->eof && total < READER_MAX_READ) {
+    /* Always leave room to terminate the last line. */
+    if (reader->len + 1 >= reader->size) {
+      reader->size *= 2;
+      reader->buf = xrealloc(reader->buf, reader->size);
+    }
+    ssize_t n = read(
+        reader->fd,
+        &reader->buf[reader->len],
+        reader->size - reader->len - 1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        log_error("Error reading input: %s.\n", strerror(errno));
+        reader->eof = true;
+      }
+      break;
+    }
+    if (n == 0) {
+      reader->eof = true;
+      break;
+    }
+
+    /* Lines can only end in what's just been read. */
+    const size_t end = reader->len + n;
+    char *start = reader->buf;
+    char *c = &reader->buf[reader->len];
+    while ((c = memchr(c, '\n', &reader->buf[end] - c)) != NULL) {
+      added += add_line(strings, seen, start, c - start);
+      start = ++c;
+    }
+    reader->len = &reader->buf[end] - start;
+    memmove(reader->buf, start, reader->len);
+    total += n;
+  }
+
+  if (reader->eof && reader->len > 0) {
+    added += add_line(strings, seen, reader->buf, reader->len);
+    reader->len = 0;
+  }
+  return added;
+}
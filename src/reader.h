@@ -0,0 +1,30 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "string_set.h"
+#include "string_vec.h"
+
+/*
+ * Reads newline-separated strings from a file descriptor a chunk at a time,
+ * without blocking, so that they can be matched while a slow producer is
+ * still writing them.
+ */
+struct reader {
+  int fd;
+  bool eof;
+  /* Input that hasn't been split into lines yet. */
+  char *buf;
+  size_t size;
+  size_t len;
+};
+
+struct reader reader_create(int fd);
+void reader_destroy(struct reader *reader);
+size_t reader_read(
+    struct reader *reader,
+    struct string_vec *strings,
+    struct string_set *seen);
+
+#endif /* READER_H */
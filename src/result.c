@@ -0,0 +1,464 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "candidate.h"
+#include "fuzzy_match.h"
+#include "log.h"
+#include "prefilter.h"
+#include "result.h"
+#include "selection.h"
+#include "workers.h"
+#include "xmalloc.h"
+
+/*
+ * Below this many candidates to score, it's not worth waking the other
+ * workers.
+ */
+#define RESULT_PARALLEL_MIN 4096
+
+/* One worker's share of a filter. */
+struct filter_chunk {
+  size_t start;
+  size_t count;
+  struct result *top;
+  size_t top_count;
+};
+
+struct filter_job {
+  const struct results *results;
+  const struct fuzzy_query *query;
+  const uint32_t *survivors;
+  size_t count;
+  struct result *buf;
+  struct filter_chunk *chunks;
+};
+
+static int32_t score_candidate(
+    const struct results *results,
+    const struct fuzzy_query *query,
+    const struct candidate *candidate)
+{
+  int32_t score = INT32_MIN;
+  switch (results->algorithm) {
+    case MATCHING_ALGORITHM_SIMPLE:
+      score = fuzzy_match_query_simple_words(query, candidate);
+      break;
+    case MATCHING_ALGORITHM_FUZZY:
+      score = fuzzy_match_query_words(query, candidate);
+      break;
+  }
+  if (score == INT32_MIN) {
+    return score;
+  }
+  return score + candidate->weight;
+}
+
+static void filter_job(void *data, size_t worker, size_t count)
+{
+  struct filter_job *job = data;
+  const struct candidate_vec *candidates = job->results->candidates;
+  const size_t k = job->results->num_results;
+  struct filter_chunk *chunk = &job->chunks[worker];
+  const size_t end = job->count * (worker + 1) / count;
+
+  chunk->start = job->count * worker / count;
+  chunk->count = 0;
+  chunk->top_count = 0;
+
+  /*
+   * A chunk can't have more matches than candidates, so each one can
+   * write its matches straight into its own part of the output.
+   */
+  for (size_t i = chunk->start; i < end; i++) {
+    const uint32_t index = job->survivors[i];
+    int32_t score = score_candidate(
+        job->results,
+        job->query,
+        &candidates->buf[index]);
+    if (score != INT32_MIN) {
+      struct result result = {
+        .index = index,
+        .score = score
+      };
+      job->buf[chunk->start + chunk->count++] = result;
+      selection_push(chunk->top, &chunk->top_count, k, result);
+    }
+  }
+}
+
+/*
+ * Score every candidate whose index is in survivors, keeping those that match.
+ */
+static void filter(
+    const struct results *results,
+    const struct fuzzy_query *query,
+    const uint32_t *survivors,
+    size_t count,
+    struct result_set *set)
+{
+  const size_t k = results->num_results;
+  size_t nworkers = results->workers->count;
+  if (count < RESULT_PARALLEL_MIN) {
+    nworkers = 1;
+  }
+
+  struct filter_job job = {
+    .results = results,
+    .query = query,
+    .survivors = survivors,
+    .count = count,
+    .buf = xmalloc((count + 1) * sizeof(*job.buf)),
+    .chunks = xcalloc(nworkers, sizeof(*job.chunks))
+  };
+  for (size_t i = 0; i < nworkers; i++) {
+    job.chunks[i].top = xmalloc((k + 1) * sizeof(*job.chunks[i].top));
+  }
+
+  if (nworkers == 1) {
+    filter_job(&job, 0, 1);
+  } else {
+    workers_run(results->workers, filter_job, &job);
+  }
+
+  /* Stitch the chunks back together, and merge their best results. */
+  set->buf = job.buf;
+  set->count = 0;
+  set->top = xmalloc((k + 1) * sizeof(*set->top));
+  set->top_count = 0;
+  for (size_t i = 0; i < nworkers; i++) {
+    struct filter_chunk *chunk = &job.chunks[i];
+    memmove(
+        &set->buf[set->count],
+        &set->buf[chunk->start],
+        chunk->count * sizeof(*set->buf));
+    set->count += chunk->count;
+    for (size_t j = 0; j < chunk->top_count; j++) {
+      selection_push(set->top, &set->top_count, k, chunk->top[j]);
+    }
+    free(chunk->top);
+  }
+  free(job.chunks);
+  selection_sort(set->top, set->top_count);
+}
+
+static void filter_all(
+    const struct results *results,
+    const struct fuzzy_query *query,
+    struct result_set *set)
+{
+  const struct candidate_vec *candidates = results->candidates;
+  uint32_t *survivors = xmalloc((candidates->count + 1) * sizeof(*survivors));
+  size_t count = prefilter_scan(
+      candidates->signatures,
+      candidates->count,
+      query->signature,
+      survivors);
+  filter(results, query, survivors, count, set);
+  free(survivors);
+}
+
+/*
+ * Everything matches an empty query, scoring just its weight, so if the
+ * candidates are in order of weight they're already ranked, and there's
+ * nothing to score or select.
+ */
+static void filter_empty(const struct results *results, struct result_set *set)
+{
+  const struct candidate_vec *candidates = results->candidates;
+  const size_t k = results->num_results;
+  set->buf = xmalloc((candidates->count + 1) * sizeof(*set->buf));
+  set->count = candidates->count;
+  for (size_t i = 0; i < candidates->count; i++) {
+    set->buf[i] = (struct result){
+      .index = i,
+      .score = candidates->buf[i].weight
+    };
+  }
+  set->top_count = set->count < k ? set->count : k;
+  set->top = xmalloc((k + 1) * sizeof(*set->top));
+  memcpy(set->top, set->buf, set->top_count * sizeof(*set->top));
+}
+
+/*
+ * Write the indices of those of count results whose signatures could match
+ * query to survivors, returning how many there were.
+ */
+static size_t prefilter_results(
+    const struct results *results,
+    const struct fuzzy_query *query,
+    const struct result *buf,
+    size_t count,
+    uint32_t *survivors)
+{
+  const uint64_t *signatures = results->candidates->signatures;
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t index = buf[i].index;
+    survivors[n] = index;
+    n += (signatures[index] & query->signature) == query->signature;
+  }
+  return n;
+}
+
+/*
+ * Anything matching a query also matches every prefix of it, in both
+ * matching modes, so only the results of the prefix need rescoring.
+ */
+static void filter_extension(
+    const struct results *results,
+    const struct fuzzy_query *query,
+    const struct result_set *prefix,
+    struct result_set *set)
+{
+  uint32_t *survivors = xmalloc((prefix->count + 1) * sizeof(*survivors));
+  size_t count = prefilter_results(
+      results,
+      query,
+      prefix->buf,
+      prefix->count,
+      survivors);
+  filter(results, query, survivors, count, set);
+  free(survivors);
+}
+
+/*
+ * Add the results in added, which are all for later candidates, to set.
+ */
+static void merge(
+    const struct results *results,
+    struct result_set *set,
+    const struct result_set *added)
+{
+  const size_t k = results->num_results;
+  set->buf = xrealloc(
+      set->buf,
+      (set->count + added->count + 1) * sizeof(*set->buf));
+  memcpy(
+      &set->buf[set->count],
+      added->buf,
+      added->count * sizeof(*set->buf));
+  set->count += added->count;
+
+  /*
+   * The best of the combined results are among the best of each, but any
+   * further pages that results_get() has ranked might not be, so they're
+   * dropped and ranked again if needed.
+   */
+  struct result *top = xmalloc((k + 1) * sizeof(*top));
+  size_t top_count = 0;
+  for (size_t i = 0; i < set->top_count && i < k; i++) {
+    selection_push(top, &top_count, k, set->top[i]);
+  }
+  for (size_t i = 0; i < added->top_count; i++) {
+    selection_push(top, &top_count, k, added->top[i]);
+  }
+  selection_sort(top, top_count);
+  free(set->top);
+  set->top = top;
+  set->top_count = top_count;
+}
+
+static bool is_prefix(const char *prefix, const char *str)
+{
+  return strncmp(prefix, str, strlen(prefix)) == 0;
+}
+
+static void pop(struct results *results)
+{
+  struct result_set *set = &results->levels[--results->depth];
+  free(set->query);
+  free(set->buf);
+  free(set->top);
+  set->query = NULL;
+  set->buf = NULL;
+  set->count = 0;
+  set->top = NULL;
+  set->top_count = 0;
+}
+
+/*
+ * Filter candidates with algorithm, keeping track of the best num_results
+ * matches, which should be enough to fill the window and the selection range.
+ */
+struct results results_create(
+    const struct candidate_vec *candidates,
+    enum matching_algorithm algorithm,
+    size_t num_results)
+{
+  struct results results = {
+    .candidates = candidates,
+    .algorithm = algorithm,
+    .num_results = num_results,
+    .workers = workers_create(0),
+    .depth = 0,
+    .size = 16
+  };
+  results.levels = xcalloc(results.size, sizeof(*results.levels));
+  return results;
+}
+
+void results_destroy(struct results *results)
+{
+  while (results->depth > 0) {
+    pop(results);
+  }
+  free(results->levels);
+  workers_destroy(results->workers);
+  results->levels = NULL;
+  results->workers = NULL;
+  results->size = 0;
+}
+
+/*
+ * Return the results for query, reusing those of earlier queries where
+ * possible.
+ */
+const struct result_set *results_update(
+    struct results *results,
+    const char *query)
+{
+  log_enter_context("results_update");
+
+  /* Forget anything typed since the last query that this one extends. */
+  while (results->depth > 0
+      && !is_prefix(results->levels[results->depth - 1].query, query)) {
+    pop(results);
+  }
+
+  if (results->depth > 0
+      && !strcmp(results->levels[results->depth - 1].query, query)) {
+    log_debug("reusing results for \"%s\"", query);
+    log_leave_context();
+    return &results->levels[results->depth - 1];
+  }
+
+  if (results->depth == results->size) {
+    results->size *= 2;
+    results->levels = xrealloc(
+        results->levels,
+        results->size * sizeof(*results->levels));
+  }
+
+  struct fuzzy_query compiled = fuzzy_query_create(query);
+  struct result_set set = {
+    .query = xstrdup(query)
+  };
+  if (compiled.count == 0 && results->candidates->by_weight) {
+    filter_empty(results, &set);
+  } else if (results->depth == 0) {
+    filter_all(results, &compiled, &set);
+  } else {
+    filter_extension(
+        results,
+        &compiled,
+        &results->levels[results->depth - 1],
+        &set);
+  }
+  fuzzy_query_destroy(&compiled);
+
+  log_debug("%zu results for \"%s\"", set.count, query);
+  results->levels[results->depth++] = set;
+  log_leave_context();
+  return &results->levels[results->depth - 1];
+}
+
+/*
+ * Candidates from first onwards have been added since the results were last
+ * updated, so score them against every query on the stack, as if they'd been
+ * there all along.
+ */
+void results_append(struct results *results, size_t first)
+{
+  const struct candidate_vec *candidates = results->candidates;
+  if (first >= candidates->count || results->depth == 0) {
+    return;
+  }
+  log_enter_context("results_append");
+
+  const size_t added_count = candidates->count - first;
+  uint32_t *survivors = xmalloc((added_count + 1) * sizeof(*survivors));
+  struct result_set added = { 0 };
+  for (size_t i = 0; i < results->depth; i++) {
+    struct result_set *set = &results->levels[i];
+    struct fuzzy_query compiled = fuzzy_query_create(set->query);
+
+    /* As in results_update(), each level only rescores the one below. */
+    size_t count;
+    if (i == 0) {
+      count = prefilter_scan(
+          &candidates->signatures[first],
+          added_count,
+          compiled.signature,
+          survivors);
+      for (size_t j = 0; j < count; j++) {
+        survivors[j] += first;
+      }
+    } else {
+      count = prefilter_results(
+          results,
+          &compiled,
+          added.buf,
+          added.count,
+          survivors);
+      free(added.buf);
+      free(added.top);
+    }
+    filter(results, &compiled, survivors, count, &added);
+    fuzzy_query_destroy(&compiled);
+
+    merge(results, set, &added);
+  }
+  free(added.buf);
+  free(added.top);
+  free(survivors);
+
+  log_debug(
+      "%zu new candidates, %zu results for \"%s\"",
+      added_count,
+      results->levels[results->depth - 1].count,
+      results->levels[results->depth - 1].query);
+  log_leave_context();
+}
+
+/* The results of the last query, or NULL if there hasn't been one. */
+const struct result_set *results_current(const struct results *results)
+{
+  if (results->depth == 0) {
+    return NULL;
+  }
+  return &results->levels[results->depth - 1];
+}
+
+/*
+ * Return the result ranked at position for the current query, or NULL if
+ * there aren't that many.
+ *
+ * Only the best num_results are ranked while filtering, so this ranks further
+ * pages of the same size on demand, as the user scrolls down.
+ */
+const struct result *results_get(struct results *results, size_t position)
+{
+  if (results->depth == 0) {
+    return NULL;
+  }
+  struct result_set *set = &results->levels[results->depth - 1];
+  if (position >= set->count) {
+    return NULL;
+  }
+
+  const size_t k = results->num_results > 0 ? results->num_results : 1;
+  while (position >= set->top_count) {
+    set->top = xrealloc(
+        set->top,
+        (set->top_count + k + 1) * sizeof(*set->top));
+    set->top_count += selection_page(
+        set->buf,
+        set->count,
+        set->top_count > 0 ? &set->top[set->top_count - 1] : NULL,
+        k,
+        &set->top[set->top_count]);
+  }
+  return &set->top[position];
+}
@@ -0,0 +1,59 @@
+#ifndef RESULT_H
+#define RESULT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "candidate.h"
+#include "workers.h"
+
+enum matching_algorithm {
+  MATCHING_ALGORITHM_SIMPLE,
+  MATCHING_ALGORITHM_FUZZY
+};
+
+struct result {
+  uint32_t index;
+  int32_t score;
+};
+
+/*
+ * The candidates matching a query, in input order, along with the best
+ * of them, best first. The best num_results are found while filtering, and
+ * more are added by results_get() as needed.
+ */
+struct result_set {
+  char *query;
+  struct result *buf;
+  size_t count;
+  struct result *top;
+  size_t top_count;
+};
+
+/*
+ * Results for the current query, along with those for each shorter query it
+ * was typed through, so that typing only has to rescore what's left and
+ * backspacing doesn't have to do anything.
+ */
+struct results {
+  const struct candidate_vec *candidates;
+  enum matching_algorithm algorithm;
+  size_t num_results;
+  struct workers *workers;
+  struct result_set *levels;
+  size_t depth;
+  size_t size;
+};
+
+struct results results_create(
+    const struct candidate_vec *candidates,
+    enum matching_algorithm algorithm,
+    size_t num_results);
+void results_destroy(struct results *results);
+const struct result_set *results_update(
+    struct results *results,
+    const char *query);
+void results_append(struct results *results, size_t first);
+const struct result_set *results_current(const struct results *results);
+const struct result *results_get(struct results *results, size_t position);
+
+#endif /* RESULT_H */
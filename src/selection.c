@@ -0,0 +1,105 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "result.h"
+#include "selection.h"
+
+/*
+ * Partial sorting of results.
+ *
+ * Only a screenful of results is ever shown, so rather than sorting every
+ * match we keep the best k in a bounded heap, which costs O(n log k). Further
+ * pages are only selected if the user scrolls that far.
+ */
+
+/*
+ * Results are ranked by score, then by input order, so that ties come out the
+ * same however the work was split up.
+ */
+bool selection_better(struct result a, struct result b)
+{
+  return a.score > b.score || (a.score == b.score && a.index < b.index);
+}
+
+static int selection_compare(const void *a, const void *b)
+{
+  const struct result *ra = a;
+  const struct result *rb = b;
+  if (selection_better(*ra, *rb)) {
+    return -1;
+  }
+  if (selection_better(*rb, *ra)) {
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Keep the best k results seen so far in a heap with the worst of them at
+ * the root, so each new result costs at most O(log k).
+ */
+void selection_push(
+    struct result *heap,
+    size_t *count,
+    size_t k,
+    struct result result)
+{
+  size_t i;
+  if (*count < k) {
+    i = (*count)++;
+    while (i > 0 && selection_better(heap[(i - 1) / 2], result)) {
+      heap[i] = heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+    heap[i] = result;
+    return;
+  }
+  if (k == 0 || !selection_better(result, heap[0])) {
+    return;
+  }
+  i = 0;
+  while (true) {
+    size_t worst = i;
+    struct result worst_result = result;
+    for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < *count; child++) {
+      if (selection_better(worst_result, heap[child])) {
+        worst = child;
+        worst_result = heap[child];
+      }
+    }
+    if (worst == i) {
+      break;
+    }
+    heap[i] = heap[worst];
+    i = worst;
+  }
+  heap[i] = result;
+}
+
+/* Turn a heap into a list, best first. */
+void selection_sort(struct result *heap, size_t count)
+{
+  qsort(heap, count, sizeof(*heap), selection_compare);
+}
+
+/*
+ * Write the best k results of buf that rank below after (or the best k
+ * overall if after is NULL) to page, best first, and return how many there
+ * were.
+ */
+size_t selection_page(
+    const struct result *buf,
+    size_t count,
+    const struct result *after,
+    size_t k,
+    struct result *page)
+{
+  size_t page_count = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (after == NULL || selection_better(*after, buf[i])) {
+      selection_push(page, &page_count, k, buf[i]);
+    }
+  }
+  selection_sort(page, page_count);
+  return page_count;
+}
@@ -0,0 +1,22 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "result.h"
+
+bool selection_better(struct result a, struct result b);
+void selection_push(
+    struct result *heap,
+    size_t *count,
+    size_t k,
+    struct result result);
+void selection_sort(struct result *heap, size_t count);
+size_t selection_page(
+    const struct result *buf,
+    size_t count,
+    const struct result *after,
+    size_t k,
+    struct result *page);
+
+#endif /* SELECTION_H */
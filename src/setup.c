@@ -40,12 +40,28 @@ static void zwlr_layer_surface_configure(
    * We want actual pixel width / height, so we have to scale the
    * values provided by Wayland.
    */
+  struct surface *surface = &window->surface;
+  int32_t surface_width;
+  int32_t surface_height;
   if (window->fractional_scale != 0) {
-    window->surface.width = scale_apply(width, window->fractional_scale);
-    window->surface.height = scale_apply(height, window->fractional_scale);
+    surface_width = scale_apply(width, window->fractional_scale);
+    surface_height = scale_apply(height, window->fractional_scale);
   } else {
-    window->surface.width  = width  * window->scale;
-    window->surface.height = height * window->scale;
+    surface_width  = width  * window->scale;
+    surface_height = height * window->scale;
+  }
+
+  /* (Re)allocate buffers to match, and draw the first frame at that size. */
+  if (surface->shm_pool_data == NULL
+      || surface->width != surface_width
+      || surface->height != surface_height) {
+    if (surface->shm_pool_data != NULL) {
+      surface_destroy(surface);
+    }
+    surface->width = surface_width;
+    surface->height = surface_height;
+    surface_init(surface, bread->wayland.global.shm);
+    surface->redraw = true;
   }
 
   zwlr_layer_surface_v1_ack_configure(
@@ -60,7 +76,7 @@ static void zwlr_layer_surface_close(
 {
   log_enter_context("zwlr_layer_surface_close");
   struct bread *bread = data;
-  //tofi->closed = true;
+  bread->closed = true;
   log_debug("Layer surface close.\n");
   log_leave_context();
 }
@@ -114,7 +130,9 @@ static void wl_keyboard_leave(
   struct wl_surface *surface)
 {
   log_enter_context("wl_keyboard_leave");
-  /* Deliberately left blank */
+  /* We won't hear about the held key being released, so stop repeating it. */
+  struct bread *bread = data;
+  bread->keyboard.repeat.active = false;
   log_leave_context();
 }
 
@@ -713,7 +731,9 @@ void setup_create_window_surface(struct bread *bread)
 {
   struct wayland *wayland = &bread->wayland;
   struct window *window = bread->window;
-  window->surface.wl_surface = create_surface(bread);
+  window->surface = (struct surface){
+    .wl_surface = create_surface(bread)
+  };
   if (window->width == 0 || window->height == 0) {
     /*
      * Workaround for compatibility with legacy behaviour.
@@ -1011,6 +1031,7 @@ void setup_determine_output(struct bread *bread)
   log_debug("First dummy roundtrip done");
   log_debug("Initialising dummy surface");
   surface_init(&surface, wayland->global.shm);
+  surface_begin(&surface);
   surface_draw(&surface);
   log_debug("Dummy surface initialised");
   log_debug("Second dummy roundtrip start");
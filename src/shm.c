@@ -10,13 +10,18 @@ int shm_allocate_file(size_t size)
   int fd = memfd_create("wl_shm", 0);
   if (fd < 0)
     return -1;
-  int ret;
-  do {
-    ret = ftruncate(fd, size);
-  } while (ret < 0 && errno == EINTR);
-  if (ret < 0) {
+  if (shm_resize_file(fd, size) < 0) {
     close(fd);
     return -1;
   }
   return fd;
 }
+
+int shm_resize_file(int fd, size_t size)
+{
+  int ret;
+  do {
+    ret = ftruncate(fd, size);
+  } while (ret < 0 && errno == EINTR);
+  return ret;
+}
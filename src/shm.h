@@ -4,5 +4,6 @@
 #include <stddef.h>
 
 int shm_allocate_file(size_t size);
+int shm_resize_file(int fd, size_t size);
 
 #endif /* SHM_H */
@@ -1,11 +1,20 @@
 #ifndef STATE_H
 #define STATE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <xkbcommon/xkbcommon.h>
 
+/* The most that can be typed, in bytes of UTF-8. */
+#define STATE_QUERY_MAX 1024
+
 struct state {
   uint32_t selected;
+  char query[STATE_QUERY_MAX];
+  size_t query_length;
+  /* Set when the query's changed, until it's next matched against. */
+  bool query_dirty;
 };
 
 #endif /* STATE_H */
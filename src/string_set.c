@@ -0,0 +1,91 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+#include "string_set.h"
+#include "xmalloc.h"
+
+/* Find the slot holding string, or the empty one it would go in. */
+static struct string_set_slot *find(
+    const struct string_set *set,
+    const char *string,
+    size_t length,
+    uint32_t h)
+{
+  const size_t mask = set->size - 1;
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    struct string_set_slot *slot = &set->slots[i];
+    if (slot->string == NULL) {
+      return slot;
+    }
+    if (slot->hash == h
+        && slot->length == length
+        && !memcmp(slot->string, string, length)) {
+      return slot;
+    }
+  }
+}
+
+static void grow(struct string_set *set)
+{
+  struct string_set_slot *old = set->slots;
+  const size_t old_size = set->size;
+  set->size *= 2;
+  set->slots = xcalloc(set->size, sizeof(*set->slots));
+  const size_t mask = set->size - 1;
+  for (size_t i = 0; i < old_size; i++) {
+    if (old[i].string == NULL) {
+      continue;
+    }
+    size_t j = old[i].hash & mask;
+    while (set->slots[j].string != NULL) {
+      j = (j + 1) & mask;
+    }
+    set->slots[j] = old[i];
+  }
+  free(old);
+}
+
+struct string_set string_set_create(void)
+{
+  struct string_set set = {
+    .count = 0,
+    .size = 256
+  };
+  set.slots = xcalloc(set.size, sizeof(*set.slots));
+  return set;
+}
+
+void string_set_destroy(struct string_set *set)
+{
+  free(set->slots);
+  set->slots = NULL;
+  set->count = 0;
+  set->size = 0;
+}
+
+/*
+ * Add the first length bytes of string to set, unless they're already there.
+ * Returns whether they were added.
+ */
+bool string_set_add(struct string_set *set, const char *string, size_t length)
+{
+  /* Keep the load factor under a half, so probe sequences stay short. */
+  if (2 * (set->count + 1) > set->size) {
+    grow(set);
+  }
+  const uint32_t h = hash_string(string, length);
+  struct string_set_slot *slot = find(set, string, length, h);
+  if (slot->string != NULL) {
+    return false;
+  }
+  *slot = (struct string_set_slot){
+    .string = string,
+    .length = length,
+    .hash = h
+  };
+  set->count++;
+  return true;
+}
@@ -0,0 +1,31 @@
+#ifndef STRING_SET_H
+#define STRING_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A set of strings, for spotting duplicates.
+ *
+ * The strings themselves aren't copied, so must outlive the set. Lookups use
+ * open addressing with linear probing, and the hash of each string is kept so
+ * that most mismatches and all rehashing avoid touching the strings.
+ */
+struct string_set_slot {
+  const char *string;
+  uint32_t length;
+  uint32_t hash;
+};
+
+struct string_set {
+  size_t count;
+  size_t size;
+  struct string_set_slot *slots;
+};
+
+struct string_set string_set_create(void);
+void string_set_destroy(struct string_set *set);
+bool string_set_add(struct string_set *set, const char *string, size_t length);
+
+#endif /* STRING_SET_H */
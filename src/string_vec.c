@@ -0,0 +1,95 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "string_vec.h"
+#include "xmalloc.h"
+
+#define STRING_VEC_BLOCK_SIZE (1 << 20)
+
+/* Start a new block with room for at least size bytes. */
+static void new_block(struct string_vec *vec, size_t size)
+{
+  if (size < STRING_VEC_BLOCK_SIZE) {
+    size = STRING_VEC_BLOCK_SIZE;
+  }
+  vec->blocks = xrealloc(
+      vec->blocks,
+      (vec->num_blocks + 1) * sizeof(*vec->blocks));
+  vec->blocks[vec->num_blocks++] = xmalloc(size);
+  vec->block_used = 0;
+  vec->block_size = size;
+}
+
+struct string_vec string_vec_create(void)
+{
+  struct string_vec vec = {
+    .count = 0,
+    .size = 128,
+  };
+  vec.entries = xcalloc(vec.size, sizeof(*vec.entries));
+  return vec;
+}
+
+void string_vec_destroy(struct string_vec *vec)
+{
+  for (size_t i = 0; i < vec->num_blocks; i++) {
+    free(vec->blocks[i]);
+  }
+  free(vec->blocks);
+  free(vec->entries);
+  vec->blocks = NULL;
+  vec->entries = NULL;
+  vec->num_blocks = 0;
+  vec->count = 0;
+  vec->size = 0;
+}
+
+/*
+ * Copy the first length bytes of string to the end of vec, returning its
+ * index. The copy is always nul-terminated.
+ */
+size_t string_vec_add(
+    struct string_vec *vec,
+    const char *string,
+    size_t length,
+    uint32_t flags)
+{
+  if (vec->count == vec->size) {
+    vec->size *= 2;
+    vec->entries = xrealloc(
+        vec->entries,
+        vec->size * sizeof(*vec->entries));
+  }
+  if (vec->num_blocks == 0 || vec->block_used + length + 1 > vec->block_size) {
+    new_block(vec, length + 1);
+  }
+
+  char *dest = &vec->blocks[vec->num_blocks - 1][vec->block_used];
+  memcpy(dest, string, length);
+  dest[length] = '\0';
+
+  vec->entries[vec->count] = (struct string_entry){
+    .block = vec->num_blocks - 1,
+    .offset = vec->block_used,
+    .length = length,
+    .flags = flags
+  };
+  vec->block_used += length + 1;
+  return vec->count++;
+}
+
+/*
+ * Remove the last string added to vec, e.g. on finding it's a duplicate. Its
+ * space is reused, as it's always at the end of the last block.
+ */
+void string_vec_pop(struct string_vec *vec)
+{
+  vec->block_used = vec->entries[--vec->count].offset;
+}
+
+const char *string_vec_get(const struct string_vec *vec, size_t index)
+{
+  const struct string_entry *entry = &vec->entries[index];
+  return &vec->blocks[entry->block][entry->offset];
+}
@@ -0,0 +1,44 @@
+#ifndef STRING_VEC_H
+#define STRING_VEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A growable list of strings.
+ *
+ * Rather than allocating each string separately, they're packed one after the
+ * other into large blocks, which are never moved or resized, so pointers to
+ * them stay valid until the list is destroyed. Each string is described by a
+ * small fixed-size entry giving where it is, how long it is and any flags
+ * the caller wants to keep with it.
+ */
+struct string_entry {
+  uint32_t block;
+  uint32_t offset;
+  uint32_t length;
+  uint32_t flags;
+};
+
+struct string_vec {
+  size_t count;
+  size_t size;
+  struct string_entry *entries;
+  char **blocks;
+  size_t num_blocks;
+  /* Space used in the last block, and its size. */
+  size_t block_used;
+  size_t block_size;
+};
+
+struct string_vec string_vec_create(void);
+void string_vec_destroy(struct string_vec *vec);
+size_t string_vec_add(
+    struct string_vec *vec,
+    const char *string,
+    size_t length,
+    uint32_t flags);
+void string_vec_pop(struct string_vec *vec);
+const char *string_vec_get(const struct string_vec *vec, size_t index);
+
+#endif /* STRING_VEC_H */
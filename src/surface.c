@@ -1,6 +1,10 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include "damage.h"
 #include "log.h"
 #include "shm.h"
 #include "surface.h"
@@ -8,6 +12,98 @@
 #undef MAX
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
+static void wl_buffer_release(void *data, struct wl_buffer *wl_buffer)
+{
+  struct surface *surface = data;
+  for (int i = 0; i < surface->num_buffers; i++) {
+    if (surface->buffers[i].wl_buffer == wl_buffer) {
+      surface->buffers[i].busy = false;
+    }
+  }
+  /* A frame was put off for want of a buffer, so it can go ahead now. */
+  if (surface->starved) {
+    surface->starved = false;
+    surface->redraw = true;
+  }
+}
+
+static const struct wl_buffer_listener wl_buffer_listener = {
+  .release = wl_buffer_release
+};
+
+static void wl_surface_frame_done(
+    void *data,
+    struct wl_callback *wl_callback,
+    uint32_t time)
+{
+  struct surface *surface = data;
+  wl_callback_destroy(wl_callback);
+  surface->frame_callback = NULL;
+}
+
+static const struct wl_callback_listener wl_surface_frame_listener = {
+  .done = wl_surface_frame_done
+};
+
+static void create_buffer(struct surface *surface, int i)
+{
+  const int offset = surface->height * surface->stride * i;
+  surface->buffers[i] = (struct surface_buffer){
+    .wl_buffer = wl_shm_pool_create_buffer(
+        surface->wl_shm_pool,
+        offset,
+        surface->width,
+        surface->height,
+        surface->stride,
+        WL_SHM_FORMAT_ARGB8888),
+    .data = surface->shm_pool_data + offset,
+    .frame = 0,
+    .busy = false
+  };
+  wl_buffer_add_listener(
+      surface->buffers[i].wl_buffer,
+      &wl_buffer_listener,
+      surface);
+}
+
+/*
+ * Grow the pool by another buffer, for when the compositor's holding on to
+ * all the others.
+ */
+static bool add_buffer(struct surface *surface)
+{
+  log_enter_context("add_buffer");
+  const int frame_size = surface->height * surface->stride;
+  const int size = frame_size * (surface->num_buffers + 1);
+  if (shm_resize_file(surface->shm_pool_fd, size) < 0) {
+    log_warning("Couldn't grow buffer pool: %s.\n", strerror(errno));
+    log_leave_context();
+    return false;
+  }
+  uint8_t *data = mremap(
+      surface->shm_pool_data,
+      surface->shm_pool_size,
+      size,
+      MREMAP_MAYMOVE);
+  if (data == MAP_FAILED) {
+    log_warning("Couldn't map buffer pool: %s.\n", strerror(errno));
+    log_leave_context();
+    return false;
+  }
+  surface->shm_pool_data = data;
+  surface->shm_pool_size = size;
+  wl_shm_pool_resize(surface->wl_shm_pool, size);
+
+  /* The pool may have moved. */
+  for (int i = 0; i < surface->num_buffers; i++) {
+    surface->buffers[i].data = data + frame_size * i;
+  }
+  create_buffer(surface, surface->num_buffers++);
+  log_debug("Grew buffer pool to %d buffers.\n", surface->num_buffers);
+  log_leave_context();
+  return true;
+}
+
 void surface_init(struct surface *surface, struct wl_shm *wl_shm)
 {
   log_enter_context("surface_init");
@@ -18,11 +114,11 @@ void surface_init(struct surface *surface, struct wl_shm *wl_shm)
   const int stride = width * 4;
   surface->stride = stride;
 
-  /* Double-buffered pool, so allocate space for two windows */
+  /* Start double-buffered, growing the pool later if need be. */
   surface->shm_pool_size =
     height
     * stride
-    * 2;
+    * SURFACE_MIN_BUFFERS;
   surface->shm_pool_fd = shm_allocate_file(surface->shm_pool_size);
   surface->shm_pool_data = mmap(
       NULL,
@@ -41,38 +137,187 @@ void surface_init(struct surface *surface, struct wl_shm *wl_shm)
       surface->shm_pool_fd,
       surface->shm_pool_size);
 
-  for (int i = 0; i < 2; i++) {
-    int offset = height * stride * i;
-    surface->buffers[i] = wl_shm_pool_create_buffer(
-        surface->wl_shm_pool,
-        offset,
-        width,
-        height,
-        stride,
-        WL_SHM_FORMAT_ARGB8888);
+  surface->num_buffers = SURFACE_MIN_BUFFERS;
+  for (int i = 0; i < surface->num_buffers; i++) {
+    create_buffer(surface, i);
   }
+  surface->back = -1;
+  surface->front = -1;
+  surface->frame = 0;
+  surface->frame_callback = NULL;
+  surface->starved = false;
+  damage_clear(&surface->damage);
   log_leave_context();
 }
 
 void surface_destroy(struct surface *surface)
 {
   log_enter_context("surface_destroy");
+  if (surface->frame_callback != NULL) {
+    wl_callback_destroy(surface->frame_callback);
+    surface->frame_callback = NULL;
+  }
   wl_shm_pool_destroy(surface->wl_shm_pool);
   munmap(surface->shm_pool_data, surface->shm_pool_size);
   surface->shm_pool_data = NULL;
   close(surface->shm_pool_fd);
-  wl_buffer_destroy(surface->buffers[0]);
-  wl_buffer_destroy(surface->buffers[1]);
+  for (int i = 0; i < surface->num_buffers; i++) {
+    wl_buffer_destroy(surface->buffers[i].wl_buffer);
+  }
+  surface->num_buffers = 0;
   log_leave_context();
 }
 
+/* Mark part of the surface as needing to be painted this frame. */
+void surface_damage(
+    struct surface *surface,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height)
+{
+  damage_add(
+      &surface->damage,
+      (struct damage_rect){ x, y, width, height },
+      surface->width,
+      surface->height);
+}
+
+void surface_damage_all(struct surface *surface)
+{
+  damage_add_all(&surface->damage, surface->width, surface->height);
+}
+
+/*
+ * Pick a buffer the compositor isn't using, preferring whichever is most up to
+ * date, as it'll need the least copying to bring up to date.
+ */
+static int choose_buffer(struct surface *surface)
+{
+  int best = -1;
+  for (int i = 0; i < surface->num_buffers; i++) {
+    const struct surface_buffer *buffer = &surface->buffers[i];
+    if (!buffer->busy
+        && (best < 0 || buffer->frame > surface->buffers[best].frame)) {
+      best = i;
+    }
+  }
+  if (best < 0
+      && surface->num_buffers < SURFACE_MAX_BUFFERS
+      && add_buffer(surface)) {
+    best = surface->num_buffers - 1;
+  }
+  return best;
+}
+
+/*
+ * Get the buffer for the next frame ready to be painted, and return its
+ * pixels.
+ *
+ * The buffer will hold whatever was last presented, except in the damaged
+ * regions, which the caller is expected to paint. Rather than repainting
+ * everything that's changed since the buffer was last used, those regions are
+ * copied across from the buffer that's on screen.
+ *
+ * If the compositor's still reading from every buffer, this returns NULL
+ * rather than wait. The damage is kept, and surface->redraw is set once a
+ * buffer's released, so the frame can be tried again then.
+ */
+uint8_t *surface_begin(struct surface *surface)
+{
+  if (surface->back >= 0) {
+    return surface->buffers[surface->back].data;
+  }
+  const int index = choose_buffer(surface);
+  if (index < 0) {
+    log_debug("All buffers busy, putting off frame.\n");
+    surface->starved = true;
+    return NULL;
+  }
+  surface->back = index;
+  struct surface_buffer *back = &surface->buffers[index];
+
+  if (surface->frame == 0) {
+    /* Nothing's been drawn yet, so there's nothing to keep. */
+    surface_damage_all(surface);
+    return back->data;
+  }
+
+  struct damage stale;
+  if (back->frame == 0
+      || surface->frame - back->frame > SURFACE_DAMAGE_HISTORY) {
+    damage_add_all(&stale, surface->width, surface->height);
+  } else {
+    damage_clear(&stale);
+    for (uint64_t f = back->frame + 1; f <= surface->frame; f++) {
+      const struct damage *past = &surface->history[f % SURFACE_DAMAGE_HISTORY];
+      for (size_t i = 0; i < past->count; i++) {
+        damage_add(&stale, past->rects[i], surface->width, surface->height);
+      }
+    }
+  }
+
+  /* There's no point copying anything that's about to be painted over. */
+  struct damage copy;
+  damage_clear(&copy);
+  for (size_t i = 0; i < stale.count; i++) {
+    if (!damage_covers(&surface->damage, stale.rects[i])) {
+      copy.rects[copy.count++] = stale.rects[i];
+    }
+  }
+  damage_copy(
+      &copy,
+      back->data,
+      surface->buffers[surface->front].data,
+      surface->stride);
+  return back->data;
+}
+
+/*
+ * Present the buffer set up by surface_begin(), telling the compositor about
+ * only the regions that were damaged, and asking to be told when it's ready
+ * for the next frame.
+ */
 void surface_draw(struct surface *surface)
 {
   log_enter_context("surface_draw");
-  wl_surface_attach(surface->wl_surface, surface->buffers[surface->index], 0, 0);
-  wl_surface_damage_buffer(surface->wl_surface, 0, 0, INT32_MAX, INT32_MAX);
+  assert(surface->back >= 0);
+  struct surface_buffer *back = &surface->buffers[surface->back];
+  wl_surface_attach(surface->wl_surface, back->wl_buffer, 0, 0);
+  for (size_t i = 0; i < surface->damage.count; i++) {
+    const struct damage_rect rect = surface->damage.rects[i];
+    wl_surface_damage_buffer(
+        surface->wl_surface,
+        rect.x,
+        rect.y,
+        rect.width,
+        rect.height);
+  }
+  surface->frame_callback = wl_surface_frame(surface->wl_surface);
+  wl_callback_add_listener(
+      surface->frame_callback,
+      &wl_surface_frame_listener,
+      surface);
   wl_surface_commit(surface->wl_surface);
 
-  surface->index = !surface->index;
+  surface->frame++;
+  back->frame = surface->frame;
+  back->busy = true;
+  surface->history[surface->frame % SURFACE_DAMAGE_HISTORY] = surface->damage;
+  damage_clear(&surface->damage);
+  surface->front = surface->back;
+  surface->back = -1;
   log_leave_context();
 }
+
+/*
+ * Whether there's something to draw and the compositor's ready for it. Until
+ * then, changes just pile up, so however many there are between frames only
+ * cost one.
+ */
+bool surface_frame_due(const struct surface *surface)
+{
+  return surface->redraw
+    && surface->shm_pool_data != NULL
+    && surface->frame_callback == NULL;
+}
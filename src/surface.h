@@ -4,6 +4,29 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <wayland-client.h>
+#include "damage.h"
+
+/*
+ * How many frames' damage is remembered, which is how far behind a buffer can
+ * fall and still be brought up to date by copying just what changed.
+ */
+#define SURFACE_DAMAGE_HISTORY 4
+
+/*
+ * Buffers start out double-buffered, with a third added only if the
+ * compositor is holding on to both when a frame needs drawing.
+ */
+#define SURFACE_MIN_BUFFERS 2
+#define SURFACE_MAX_BUFFERS 3
+
+struct surface_buffer {
+  struct wl_buffer *wl_buffer;
+  uint8_t *data;
+  /* The frame last drawn into this buffer, or 0 if it's never been used. */
+  uint64_t frame;
+  /* Whether the compositor may still be reading from this buffer. */
+  bool busy;
+};
 
 struct surface {
   struct wl_surface *wl_surface;
@@ -11,12 +34,26 @@ struct surface {
   int32_t width;
   int32_t height;
   int32_t stride;
-  int index;
-  struct wl_buffer *buffers[2];
+  /* The buffer being drawn, if any, and the one last presented. */
+  int back;
+  int front;
+  int num_buffers;
+  struct surface_buffer buffers[SURFACE_MAX_BUFFERS];
 
   int shm_pool_size;
   int shm_pool_fd;
   uint8_t *shm_pool_data;
+
+  /* What's changed in the frame being drawn. */
+  struct damage damage;
+  /* What changed in each of the last few frames, indexed by frame number. */
+  struct damage history[SURFACE_DAMAGE_HISTORY];
+  /* The number of frames drawn so far. */
+  uint64_t frame;
+  /* Outstanding until the compositor's ready for another frame. */
+  struct wl_callback *frame_callback;
+  /* Set when a frame couldn't be drawn for lack of a free buffer. */
+  bool starved;
   bool redraw;
 };
 
@@ -24,6 +61,15 @@ void surface_init(
     struct surface *surface,
     struct wl_shm *wl_shm);
 void surface_destroy(struct surface *surface);
+void surface_damage(
+    struct surface *surface,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height);
+void surface_damage_all(struct surface *surface);
+uint8_t *surface_begin(struct surface *surface);
 void surface_draw(struct surface *surface);
+bool surface_frame_due(const struct surface *surface);
 
 #endif /* SURFACE_H */
@@ -2,15 +2,31 @@
 #include <string.h>
 
 #include "unicode.h"
+#include "xmalloc.h"
 
 uint8_t utf32_to_utf8(uint32_t c, char *buf)
 {
-	return g_unichar_to_utf8(c, buf);
-}
-
-uint32_t utf8_to_utf32(const char *s)
-{
-	return g_utf8_get_char(s);
+	unsigned char *p = (unsigned char *)buf;
+	if (c < 0x80) {
+		p[0] = c;
+		return 1;
+	}
+	if (c < 0x800) {
+		p[0] = 0xC0 | (c >> 6);
+		p[1] = 0x80 | (c & 0x3F);
+		return 2;
+	}
+	if (c < 0x10000) {
+		p[0] = 0xE0 | (c >> 12);
+		p[1] = 0x80 | ((c >> 6) & 0x3F);
+		p[2] = 0x80 | (c & 0x3F);
+		return 3;
+	}
+	p[0] = 0xF0 | (c >> 18);
+	p[1] = 0x80 | ((c >> 12) & 0x3F);
+	p[2] = 0x80 | ((c >> 6) & 0x3F);
+	p[3] = 0x80 | (c & 0x3F);
+	return 4;
 }
 
 uint32_t utf8_to_utf32_validate(const char *s)
@@ -23,41 +39,6 @@ uint32_t *utf8_string_to_utf32_string(const char *s)
 	return g_utf8_to_ucs4_fast(s, -1, NULL);
 }
 
-uint32_t utf32_isprint(uint32_t c)
-{
-	return g_unichar_isprint(c);
-}
-
-uint32_t utf32_isspace(uint32_t c)
-{
-	return g_unichar_isspace(c);
-}
-
-uint32_t utf32_isupper(uint32_t c)
-{
-	return g_unichar_isupper(c);
-}
-
-uint32_t utf32_islower(uint32_t c)
-{
-	return g_unichar_islower(c);
-}
-
-uint32_t utf32_isalnum(uint32_t c)
-{
-	return g_unichar_isalnum(c);
-}
-
-uint32_t utf32_toupper(uint32_t c)
-{
-	return g_unichar_toupper(c);
-}
-
-uint32_t utf32_tolower(uint32_t c)
-{
-	return g_unichar_tolower(c);
-}
-
 size_t utf32_strlen(const uint32_t *s)
 {
 	size_t len = 0;
@@ -67,16 +48,6 @@ size_t utf32_strlen(const uint32_t *s)
 	return len;
 }
 
-char *utf8_next_char(const char *s)
-{
-	return g_utf8_next_char(s);
-}
-
-char *utf8_prev_char(const char *s)
-{
-	return g_utf8_prev_char(s);
-}
-
 char *utf8_strchr(const char *s, uint32_t c)
 {
 	return g_utf8_strchr(s, -1, c);
@@ -84,11 +55,11 @@ char *utf8_strchr(const char *s, uint32_t c)
 
 char *utf8_strcasechr(const char *s, uint32_t c)
 {
-	c = g_unichar_tolower(c);
+	c = utf32_tolower(c);
 
 	const char *p = s;
-	while (*p != '\0' && g_unichar_tolower(g_utf8_get_char(p)) != c) {
-		p = g_utf8_next_char(p);
+	while (*p != '\0' && utf32_tolower(utf8_to_utf32(p)) != c) {
+		p = utf8_next_char(p);
 	}
 	if (*p == '\0') {
 		return NULL;
@@ -101,24 +72,27 @@ size_t utf8_strlen(const char *s)
 	return g_utf8_strlen(s, -1);
 }
 
+/*
+ * Find the first occurrence of needle in haystack, comparing characters by
+ * utf32_tolower() just as utf8_strcasechr() and utf8_fold() do.
+ */
 char *utf8_strcasestr(const char * restrict haystack, const char * restrict needle)
 {
-	char *h = g_utf8_casefold(haystack, -1);
-	char *n = g_utf8_casefold(needle, -1);
-
-	char *cmp = strstr(h, n);
-	char *ret;
-
-	if (cmp == NULL) {
-		ret = NULL;
-	} else {
-		ret = (char *)haystack + (cmp - h);
+	for (const char *h = haystack;; h = utf8_next_char(h)) {
+		const char *a = h;
+		const char *b = needle;
+		while (*a != '\0' && *b != '\0'
+				&& utf32_tolower(utf8_to_utf32(a)) == utf32_tolower(utf8_to_utf32(b))) {
+			a = utf8_next_char(a);
+			b = utf8_next_char(b);
+		}
+		if (*b == '\0') {
+			return (char *)h;
+		}
+		if (*h == '\0') {
+			return NULL;
+		}
 	}
-
-	free(h);
-	free(n);
-
-	return ret;
 }
 
 char *utf8_normalize(const char *s)
@@ -131,7 +105,102 @@ char *utf8_compose(const char *s)
 	return g_utf8_normalize(s, -1, G_NORMALIZE_DEFAULT_COMPOSE);
 }
 
-bool utf8_validate(const char *s)
+/*
+ * Write the utf32_tolower() of the character at c to buf, returning its
+ * length in bytes.
+ */
+static uint8_t fold_char(const char *c, char *buf)
+{
+	if ((unsigned char)*c < 0x80) {
+		buf[0] = (char)utf32_tolower((unsigned char)*c);
+		return 1;
+	}
+	return utf32_to_utf8(utf32_tolower(utf8_to_utf32(c)), buf);
+}
+
+/*
+ * The length in bytes of utf8_fold() of the first length bytes of s, not
+ * counting the terminating NUL, so that its result can be put wherever the
+ * caller likes with utf8_fold_to().
+ *
+ * same_offsets is set to whether every character folds to one of the same
+ * number of bytes, in which case no map is needed.
+ */
+size_t utf8_fold_length(const char *s, size_t length, bool *same_offsets)
+{
+	size_t len = 0;
+	*same_offsets = true;
+	for (const char *c = s; c < s + length; c = utf8_next_char(c)) {
+		char buf[4];
+		const size_t n = fold_char(c, buf);
+		*same_offsets &= n == (size_t)(utf8_next_char(c) - c);
+		len += n;
+	}
+	return len;
+}
+
+/*
+ * Case-fold the first length bytes of s into folded, which must have room for
+ * utf8_fold_length() bytes plus a NUL. If map is not NULL, it's filled in as
+ * described for utf8_fold(), and must have room for as many offsets.
+ */
+void utf8_fold_to(const char *s, size_t length, char *folded, uint32_t *map)
+{
+	size_t len = 0;
+	for (const char *c = s; c < s + length; c = utf8_next_char(c)) {
+		const size_t n = fold_char(c, &folded[len]);
+		if (map != NULL) {
+			for (size_t i = 0; i < n; i++) {
+				map[len + i] = c - s;
+			}
+		}
+		len += n;
+	}
+	folded[len] = '\0';
+	if (map != NULL) {
+		map[len] = length;
+	}
+}
+
+/*
+ * Case-fold the first length bytes of s for matching, one character at a time
+ * so that each byte of the result can be traced back to the character of s it
+ * came from.
+ *
+ * Each character is folded with utf32_tolower(), which is how the unprepared
+ * matchers compare characters, rather than with full Unicode case folding,
+ * so "ß" stays as it is rather than becoming "ss". Nor is s normalised, so
+ * composed and decomposed characters stay as they are, just as the
+ * unprepared matchers leave their str alone. Patterns are NFD-normalised
+ * before folding on both paths, so "o" matches a decomposed "ọ" but not a
+ * composed one. Together, that means fuzzy_match_query_words() and
+ * fuzzy_match_query_simple_words() give the same results as
+ * fuzzy_match_words() and fuzzy_match_simple_words().
+ *
+ * If map is not NULL, it's set to an array giving, for each byte of the
+ * result (plus the terminating NUL), the byte offset into s of the character
+ * it came from. If every character folds to one of the same number of bytes,
+ * the offsets of character boundaries are unchanged, so it's set to NULL
+ * instead. This is always the case for plain ASCII.
+ */
+char *utf8_fold(const char *s, size_t length, uint32_t **map)
+{
+	bool same_offsets;
+	const size_t len = utf8_fold_length(s, length, &same_offsets);
+	char *folded = xmalloc(len + 1);
+	uint32_t *offsets = NULL;
+
+	if (map != NULL && !same_offsets) {
+		offsets = xmalloc((len + 1) * sizeof(*offsets));
+	}
+	utf8_fold_to(s, length, folded, offsets);
+	if (map != NULL) {
+		*map = offsets;
+	}
+	return folded;
+}
+
+bool utf8_validate(const char *s, size_t length)
 {
-	return g_utf8_validate(s, -1, NULL);
+	return g_utf8_validate(s, length, NULL);
 }
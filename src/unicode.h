@@ -4,29 +4,137 @@
 #include <glib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include "unicode_tables.h"
 
 uint8_t utf32_to_utf8(uint32_t c, char *buf);
-uint32_t utf8_to_utf32(const char *s);
 uint32_t utf8_to_utf32_validate(const char *s);
 uint32_t *utf8_string_to_utf32_string(const char *s);
 
-uint32_t utf32_isprint(uint32_t c);
-uint32_t utf32_isspace(uint32_t c);
-uint32_t utf32_isupper(uint32_t c);
-uint32_t utf32_islower(uint32_t c);
-uint32_t utf32_isalnum(uint32_t c);
-uint32_t utf32_toupper(uint32_t c);
-uint32_t utf32_tolower(uint32_t c);
 size_t utf32_strlen(const uint32_t *s);
 
-char *utf8_next_char(const char *s);
-char *utf8_prev_char(const char *s);
 char *utf8_strchr(const char *s, uint32_t c);
 char *utf8_strcasechr(const char *s, uint32_t c);
 size_t utf8_strlen(const char *s);
 char *utf8_strcasestr(const char * restrict haystack, const char * restrict needle);
 char *utf8_normalize(const char *s);
 char *utf8_compose(const char *s);
-bool utf8_validate(const char *s);
+char *utf8_fold(const char *s, size_t length, uint32_t **map);
+size_t utf8_fold_length(const char *s, size_t length, bool *same_offsets);
+void utf8_fold_to(const char *s, size_t length, char *folded, uint32_t *map);
+bool utf8_validate(const char *s, size_t length);
+
+/*
+ * The functions below sit in the matcher's inner loops, so they are inlined
+ * and use the generated tables in unicode_tables.h rather than calling into
+ * glib. Input is assumed to be valid UTF-8.
+ */
+
+static inline uint32_t utf8_to_utf32(const char *s)
+{
+	const unsigned char *p = (const unsigned char *)s;
+	if (p[0] < 0x80) {
+		return p[0];
+	}
+	if (p[0] < 0xE0) {
+		return (uint32_t)(p[0] & 0x1F) << 6
+			| (p[1] & 0x3F);
+	}
+	if (p[0] < 0xF0) {
+		return (uint32_t)(p[0] & 0x0F) << 12
+			| (uint32_t)(p[1] & 0x3F) << 6
+			| (p[2] & 0x3F);
+	}
+	return (uint32_t)(p[0] & 0x07) << 18
+		| (uint32_t)(p[1] & 0x3F) << 12
+		| (uint32_t)(p[2] & 0x3F) << 6
+		| (p[3] & 0x3F);
+}
+
+static inline char *utf8_next_char(const char *s)
+{
+	const unsigned char c = (unsigned char)*s;
+	if (c < 0xC0) {
+		return (char *)s + 1;
+	}
+	if (c < 0xE0) {
+		return (char *)s + 2;
+	}
+	if (c < 0xF0) {
+		return (char *)s + 3;
+	}
+	return (char *)s + 4;
+}
+
+static inline char *utf8_prev_char(const char *s)
+{
+	do {
+		s--;
+	} while (((unsigned char)*s & 0xC0) == 0x80);
+	return (char *)s;
+}
+
+static inline uint32_t utf32_class(uint32_t c)
+{
+	if (c < 0x80) {
+		return unicode_class_blocks[c];
+	}
+	if (c > UNICODE_MAX) {
+		return 0;
+	}
+	return unicode_class_blocks[
+		unicode_class_index[c >> UNICODE_BLOCK_SHIFT]
+		+ (c & (UNICODE_BLOCK_SIZE - 1))];
+}
+
+static inline uint32_t utf32_isprint(uint32_t c)
+{
+	return utf32_class(c) & UNICODE_CLASS_PRINT;
+}
+
+static inline uint32_t utf32_isspace(uint32_t c)
+{
+	return utf32_class(c) & UNICODE_CLASS_SPACE;
+}
+
+static inline uint32_t utf32_isupper(uint32_t c)
+{
+	return utf32_class(c) & UNICODE_CLASS_UPPER;
+}
+
+static inline uint32_t utf32_islower(uint32_t c)
+{
+	return utf32_class(c) & UNICODE_CLASS_LOWER;
+}
+
+static inline uint32_t utf32_isalnum(uint32_t c)
+{
+	return utf32_class(c) & UNICODE_CLASS_ALNUM;
+}
+
+static inline uint32_t utf32_toupper(uint32_t c)
+{
+	if (c < 0x80) {
+		return c - 'a' < 26 ? c - ('a' - 'A') : c;
+	}
+	if (c > UNICODE_MAX) {
+		return c;
+	}
+	return c + (uint32_t)unicode_upper_blocks[
+		unicode_upper_index[c >> UNICODE_BLOCK_SHIFT]
+		+ (c & (UNICODE_BLOCK_SIZE - 1))];
+}
+
+static inline uint32_t utf32_tolower(uint32_t c)
+{
+	if (c < 0x80) {
+		return c - 'A' < 26 ? c + ('a' - 'A') : c;
+	}
+	if (c > UNICODE_MAX) {
+		return c;
+	}
+	return c + (uint32_t)unicode_lower_blocks[
+		unicode_lower_index[c >> UNICODE_BLOCK_SHIFT]
+		+ (c & (UNICODE_BLOCK_SIZE - 1))];
+}
 
 #endif /* UNICODE_H */
@@ -0,0 +1,38 @@
+#ifndef UNICODE_TABLES_H
+#define UNICODE_TABLES_H
+
+#include <stdint.h>
+
+/*
+ * Two-stage lookup tables for Unicode character properties, generated at
+ * build time from glib by tools/gen_unicode_tables.c.
+ *
+ * The code point space is split into blocks of UNICODE_BLOCK_SIZE. The index
+ * tables give the offset of each block's data in the corresponding blocks
+ * table, where identical blocks are only stored once. The first block is
+ * always stored first, so ASCII can be looked up directly.
+ */
+
+#define UNICODE_MAX 0x10FFFF
+#define UNICODE_BLOCK_SHIFT 8
+#define UNICODE_BLOCK_SIZE (1 << UNICODE_BLOCK_SHIFT)
+#define UNICODE_NUM_BLOCKS ((UNICODE_MAX >> UNICODE_BLOCK_SHIFT) + 1)
+
+enum unicode_class {
+  UNICODE_CLASS_PRINT = 1 << 0,
+  UNICODE_CLASS_SPACE = 1 << 1,
+  UNICODE_CLASS_UPPER = 1 << 2,
+  UNICODE_CLASS_LOWER = 1 << 3,
+  UNICODE_CLASS_ALNUM = 1 << 4,
+};
+
+extern const uint32_t unicode_class_index[UNICODE_NUM_BLOCKS];
+extern const uint8_t unicode_class_blocks[];
+
+/* Case mappings are stored as the difference from the original character. */
+extern const uint32_t unicode_lower_index[UNICODE_NUM_BLOCKS];
+extern const int32_t unicode_lower_blocks[];
+extern const uint32_t unicode_upper_index[UNICODE_NUM_BLOCKS];
+extern const int32_t unicode_upper_blocks[];
+
+#endif /* UNICODE_TABLES_H */
@@ -0,0 +1,123 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "log.h"
+#include "workers.h"
+#include "xmalloc.h"
+
+struct worker_arg {
+  struct workers *workers;
+  size_t index;
+};
+
+static void *worker_main(void *data)
+{
+  struct worker_arg *arg = data;
+  struct workers *workers = arg->workers;
+  const size_t index = arg->index;
+  free(arg);
+
+  size_t generation = 0;
+  pthread_mutex_lock(&workers->lock);
+  while (true) {
+    while (!workers->quit && workers->generation == generation) {
+      pthread_cond_wait(&workers->start, &workers->lock);
+    }
+    if (workers->quit) {
+      break;
+    }
+    generation = workers->generation;
+    workers_job job = workers->job;
+    void *job_data = workers->data;
+    pthread_mutex_unlock(&workers->lock);
+
+    job(job_data, index, workers->count);
+
+    pthread_mutex_lock(&workers->lock);
+    if (--workers->pending == 0) {
+      pthread_cond_signal(&workers->done);
+    }
+  }
+  pthread_mutex_unlock(&workers->lock);
+  return NULL;
+}
+
+/*
+ * Create a pool of count workers, or one per online CPU if count is 0.
+ */
+struct workers *workers_create(size_t count)
+{
+  log_enter_context("workers_create");
+  if (count == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    count = cpus > 0 ? cpus : 1;
+  }
+
+  struct workers *workers = xcalloc(1, sizeof(*workers));
+  workers->count = count;
+  workers->threads = xcalloc(count, sizeof(*workers->threads));
+  pthread_mutex_init(&workers->lock, NULL);
+  pthread_cond_init(&workers->start, NULL);
+  pthread_cond_init(&workers->done, NULL);
+
+  for (size_t i = 1; i < count; i++) {
+    struct worker_arg *arg = xmalloc(sizeof(*arg));
+    arg->workers = workers;
+    arg->index = i;
+    if (pthread_create(&workers->threads[i], NULL, worker_main, arg) != 0) {
+      /* Make do with the threads we've got. */
+      log_warning("Failed to start worker thread, using %zu.\n", i);
+      free(arg);
+      workers->count = i;
+      break;
+    }
+  }
+  log_debug("%zu workers", workers->count);
+  log_leave_context();
+  return workers;
+}
+
+void workers_destroy(struct workers *workers)
+{
+  pthread_mutex_lock(&workers->lock);
+  workers->quit = true;
+  pthread_cond_broadcast(&workers->start);
+  pthread_mutex_unlock(&workers->lock);
+  for (size_t i = 1; i < workers->count; i++) {
+    pthread_join(workers->threads[i], NULL);
+  }
+  pthread_cond_destroy(&workers->done);
+  pthread_cond_destroy(&workers->start);
+  pthread_mutex_destroy(&workers->lock);
+  free(workers->threads);
+  free(workers);
+}
+
+/*
+ * Run job(data, worker, count) on every worker, and wait for them all to
+ * finish.
+ */
+void workers_run(struct workers *workers, workers_job job, void *data)
+{
+  if (workers->count > 1) {
+    pthread_mutex_lock(&workers->lock);
+    workers->job = job;
+    workers->data = data;
+    workers->pending = workers->count - 1;
+    workers->generation++;
+    pthread_cond_broadcast(&workers->start);
+    pthread_mutex_unlock(&workers->lock);
+  }
+
+  job(data, 0, workers->count);
+
+  if (workers->count > 1) {
+    pthread_mutex_lock(&workers->lock);
+    while (workers->pending > 0) {
+      pthread_cond_wait(&workers->done, &workers->lock);
+    }
+    pthread_mutex_unlock(&workers->lock);
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*workers_job)(void *data, size_t worker, size_t count);
+
+/*
+ * A pool of threads that all run the same job, each on their own share of
+ * the work. The calling thread takes part as worker 0.
+ */
+struct workers {
+  size_t count;
+  pthread_t *threads;
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  workers_job job;
+  void *data;
+  size_t generation;
+  size_t pending;
+  bool quit;
+};
+
+struct workers *workers_create(size_t count);
+void workers_destroy(struct workers *workers);
+void workers_run(struct workers *workers, workers_job job, void *data);
+
+#endif /* WORKERS_H */
@@ -0,0 +1,346 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "candidate.h"
+#include "fuzzy_match.h"
+
+/*
+ * Matcher benchmarks, run with `meson test --benchmark`.
+ *
+ * Each corpus is generated from a fixed seed, so numbers are comparable
+ * between builds. For every query, we time a full pass over the corpus for
+ * each prefix of it, as if it was being typed, and report the time per
+ * candidate and the median and 99th percentile time per keystroke. The time
+ * taken to prepare each candidate when it's loaded is reported too.
+ */
+
+#define CORPUS_SIZE 20000
+#define KEYSTROKE_RUNS 3
+
+struct corpus {
+	const char *name;
+	char **lines;
+	size_t count;
+	const char **queries;
+};
+
+static uint64_t seed;
+
+static uint32_t next_random(void)
+{
+	/* xorshift64*, so results don't depend on the libc. */
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return (seed * UINT64_C(2685821657736338717)) >> 32;
+}
+
+static const char *pick(const char *const *words, size_t count)
+{
+	return words[next_random() % count];
+}
+
+static char *append(char *buf, size_t *len, size_t *size, const char *str)
+{
+	size_t n = strlen(str);
+	if (*len + n + 1 > *size) {
+		*size = 2 * (*len + n + 1);
+		buf = realloc(buf, *size);
+	}
+	memcpy(&buf[*len], str, n + 1);
+	*len += n;
+	return buf;
+}
+
+static const char *const path_words[] = {
+	"usr", "share", "lib", "local", "bin", "src", "home", "user", "projects",
+	"bread", "include", "node_modules", "target", "release", "icons",
+	"hicolor", "scalable", "apps", "locale", "LC_MESSAGES", "python3.11",
+	"site-packages", "__pycache__", "test", "docs", "build", "CMakeFiles"
+};
+static const char *const path_exts[] = {
+	".c", ".h", ".py", ".so", ".svg", ".png", ".mo", ".txt", ".json", ""
+};
+static const char *const app_words[] = {
+	"Firefox", "Web", "Browser", "Terminal", "Files", "Text", "Editor",
+	"Settings", "System", "Monitor", "Image", "Viewer", "Music", "Player",
+	"Calculator", "Disk", "Usage", "Analyzer", "Document", "Scanner",
+	"LibreOffice", "Writer", "Calc", "Impress", "GIMP", "Inkscape"
+};
+static const char *const intl_words[] = {
+	"Файлы", "Настройки", "Терминал", "Браузер", "Музыка", "Документы",
+	"文件", "设置", "终端", "浏览器", "音乐", "文档", "ファイル", "設定",
+	"端末", "ブラウザ", "音楽", "文書"
+};
+static const char *const log_words[] = {
+	"INFO", "WARN", "ERROR", "DEBUG", "systemd[1]:", "kernel:", "Started",
+	"Stopped", "session", "user", "service", "unit", "failed", "with",
+	"result", "exit-code", "connection", "from", "port", "accepted",
+	"NetworkManager", "dhcp4", "state", "changed", "bound", "renewing"
+};
+
+static char *make_path(void)
+{
+	size_t len = 0;
+	size_t size = 0;
+	char *buf = NULL;
+	size_t depth = 2 + next_random() % 8;
+	for (size_t i = 0; i < depth; i++) {
+		buf = append(buf, &len, &size, "/");
+		buf = append(buf, &len, &size, pick(path_words, sizeof(path_words) / sizeof(*path_words)));
+	}
+	buf = append(buf, &len, &size, pick(path_exts, sizeof(path_exts) / sizeof(*path_exts)));
+	return buf;
+}
+
+static char *make_words(const char *const *words, size_t count, size_t min, size_t max)
+{
+	size_t len = 0;
+	size_t size = 0;
+	char *buf = NULL;
+	size_t n = min + next_random() % (max - min + 1);
+	for (size_t i = 0; i < n; i++) {
+		if (i > 0) {
+			buf = append(buf, &len, &size, " ");
+		}
+		buf = append(buf, &len, &size, pick(words, count));
+	}
+	return buf;
+}
+
+static char *make_app(void)
+{
+	return make_words(app_words, sizeof(app_words) / sizeof(*app_words), 1, 3);
+}
+
+static char *make_intl(void)
+{
+	return make_words(intl_words, sizeof(intl_words) / sizeof(*intl_words), 1, 4);
+}
+
+static char *make_log(void)
+{
+	return make_words(log_words, sizeof(log_words) / sizeof(*log_words), 20, 40);
+}
+
+static char *make_worst(void)
+{
+	/* One repeated letter is the worst case for fuzzy matching. */
+	size_t n = 50 + next_random() % 150;
+	char *buf = malloc(n + 1);
+	memset(buf, 'a', n);
+	buf[n] = '\0';
+	return buf;
+}
+
+static struct corpus make_corpus(const char *name, char *(*make)(void), const char **queries)
+{
+	struct corpus corpus = {
+		.name = name,
+		.lines = malloc(CORPUS_SIZE * sizeof(char *)),
+		.count = CORPUS_SIZE,
+		.queries = queries
+	};
+	for (size_t i = 0; i < corpus.count; i++) {
+		corpus.lines[i] = make();
+	}
+	return corpus;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	const uint64_t ua = *(const uint64_t *)a;
+	const uint64_t ub = *(const uint64_t *)b;
+	return (ua > ub) - (ua < ub);
+}
+
+enum matcher {
+	MATCHER_FUZZY_MATCH,
+	MATCHER_FUZZY_MATCH_WORDS,
+	MATCHER_FUZZY_MATCH_SIMPLE_WORDS,
+	MATCHER_QUERY_WORDS,
+	MATCHER_QUERY_SIMPLE_WORDS,
+	NUM_MATCHERS
+};
+
+static const char *const matcher_names[NUM_MATCHERS] = {
+	"fuzzy_match",
+	"fuzzy_match_words",
+	"fuzzy_match_simple_words",
+	"fuzzy_match_query_words",
+	"fuzzy_match_query_simple_words"
+};
+
+/*
+ * fuzzy_match() takes a single word, so sum it over each word of the query,
+ * as fuzzy_match_words() does, but without normalising anything.
+ */
+static int32_t fuzzy_match_each(char *const *words, size_t count, const char *str)
+{
+	int32_t score = 0;
+	for (size_t i = 0; i < count; i++) {
+		int32_t word_score = fuzzy_match(words[i], str);
+		if (word_score == INT32_MIN) {
+			return INT32_MIN;
+		}
+		score += word_score;
+	}
+	return score;
+}
+
+/* Time one pass over the corpus, returning the number of matches. */
+static size_t run_pass(
+		enum matcher matcher,
+		const struct corpus *corpus,
+		const struct candidate *candidates,
+		const char *query)
+{
+	size_t matches = 0;
+	struct fuzzy_query compiled = fuzzy_query_create(query);
+
+	/* Queries are at most 63 bytes, so can't have more than 32 words. */
+	char *copy = strdup(query);
+	char *words[32];
+	size_t num_words = 0;
+	char *saveptr = NULL;
+	for (char *word = strtok_r(copy, " ", &saveptr);
+			word != NULL;
+			word = strtok_r(NULL, " ", &saveptr)) {
+		words[num_words++] = word;
+	}
+
+	for (size_t i = 0; i < corpus->count; i++) {
+		int32_t score = INT32_MIN;
+		switch (matcher) {
+			case MATCHER_FUZZY_MATCH:
+				score = fuzzy_match_each(words, num_words, corpus->lines[i]);
+				break;
+			case MATCHER_FUZZY_MATCH_WORDS:
+				score = fuzzy_match_words(query, corpus->lines[i]);
+				break;
+			case MATCHER_FUZZY_MATCH_SIMPLE_WORDS:
+				score = fuzzy_match_simple_words(query, corpus->lines[i]);
+				break;
+			case MATCHER_QUERY_WORDS:
+				score = fuzzy_match_query_words(&compiled, &candidates[i]);
+				break;
+			case MATCHER_QUERY_SIMPLE_WORDS:
+				score = fuzzy_match_query_simple_words(&compiled, &candidates[i]);
+				break;
+			case NUM_MATCHERS:
+				break;
+		}
+		matches += score != INT32_MIN;
+	}
+	fuzzy_query_destroy(&compiled);
+	free(copy);
+	return matches;
+}
+
+static void bench(enum matcher matcher, const struct corpus *corpus, const struct candidate *candidates)
+{
+	size_t keystrokes = 0;
+	for (const char **q = corpus->queries; *q != NULL; q++) {
+		keystrokes += strlen(*q);
+	}
+	keystrokes *= KEYSTROKE_RUNS;
+
+	uint64_t *times = malloc(keystrokes * sizeof(*times));
+	uint64_t total = 0;
+	size_t n = 0;
+	size_t matches = 0;
+	for (size_t run = 0; run < KEYSTROKE_RUNS; run++) {
+		for (const char **q = corpus->queries; *q != NULL; q++) {
+			char buf[64];
+			size_t len = strlen(*q);
+			for (size_t i = 1; i <= len; i++) {
+				/* Skip the middle of multi-byte characters. */
+				if (i < len && ((*q)[i] & 0xC0) == 0x80) {
+					times[n++] = 0;
+					continue;
+				}
+				memcpy(buf, *q, i);
+				buf[i] = '\0';
+				uint64_t start = now_ns();
+				matches += run_pass(matcher, corpus, candidates, buf);
+				times[n] = now_ns() - start;
+				total += times[n++];
+			}
+		}
+	}
+
+	/* Drop the placeholders for partial characters. */
+	size_t m = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (times[i] != 0) {
+			times[m++] = times[i];
+		}
+	}
+	qsort(times, m, sizeof(*times), compare_u64);
+	printf("%-14s %-32s %10.1f %12.3f %12.3f %10zu\n",
+			corpus->name,
+			matcher_names[matcher],
+			(double)total / (m * corpus->count),
+			times[m / 2] / 1e6,
+			times[m * 99 / 100] / 1e6,
+			matches / KEYSTROKE_RUNS);
+	free(times);
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	static const char *path_queries[] = { "srcbread", "usr share icons svg", "pycache", NULL };
+	static const char *app_queries[] = { "firefox", "text ed", "lbo", NULL };
+	static const char *intl_queries[] = { "настр", "浏览", "ファイル", NULL };
+	static const char *log_queries[] = { "error failed", "sysd start", "dhcp bound", NULL };
+	static const char *worst_queries[] = { "aaaaaaaaaa", "aaaaab", NULL };
+
+	seed = 0x62726561640a;
+	struct corpus corpora[] = {
+		make_corpus("paths", make_path, path_queries),
+		make_corpus("desktop", make_app, app_queries),
+		make_corpus("cyrillic-cjk", make_intl, intl_queries),
+		make_corpus("log-lines", make_log, log_queries),
+		make_corpus("one-letter", make_worst, worst_queries),
+	};
+	const size_t num_corpora = sizeof(corpora) / sizeof(*corpora);
+
+	printf("%-14s %-32s %10s %12s %12s %10s\n",
+			"corpus", "matcher", "ns/cand", "p50 ms/key", "p99 ms/key", "matches");
+	for (size_t c = 0; c < num_corpora; c++) {
+		struct corpus *corpus = &corpora[c];
+		struct candidate_vec vec = candidate_vec_create();
+		uint64_t start = now_ns();
+		for (size_t i = 0; i < corpus->count; i++) {
+			candidate_vec_add(&vec, corpus->lines[i], strlen(corpus->lines[i]));
+		}
+		printf("%-14s %-32s %10.1f %12s %12s %10s\n",
+				corpus->name,
+				"candidate_vec_add",
+				(double)(now_ns() - start) / corpus->count,
+				"-", "-", "-");
+		for (enum matcher m = 0; m < NUM_MATCHERS; m++) {
+			bench(m, corpus, vec.buf);
+		}
+		candidate_vec_destroy(&vec);
+		for (size_t i = 0; i < corpus->count; i++) {
+			free(corpus->lines[i]);
+		}
+		free(corpus->lines);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include <fcntl.h>
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "compgen.h"
+#include "string_vec.h"
+#include "tap.h"
+
+static void make_file(const char *dir, const char *name, mode_t mode)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode);
+	if (fd == -1) {
+		abort();
+	}
+	close(fd);
+}
+
+static char *list(const struct string_vec *vec)
+{
+	static char buf[1024];
+	buf[0] = '\0';
+	for (size_t i = 0; i < vec->count; i++) {
+		if (i > 0) {
+			strcat(buf, " ");
+		}
+		strcat(buf, string_vec_get(vec, i));
+	}
+	return buf;
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	char root[] = "/tmp/bread-compgen-XXXXXX";
+	if (mkdtemp(root) == NULL) {
+		return EXIT_FAILURE;
+	}
+	char a[256];
+	char b[256];
+	char path[4096];
+	snprintf(a, sizeof(a), "%s/a", root);
+	snprintf(b, sizeof(b), "%s/b", root);
+	mkdir(a, 0755);
+	mkdir(b, 0755);
+
+	make_file(a, "zed", 0755);
+	make_file(a, "alpha", 0755);
+	make_file(a, "data", 0644);
+	make_file(b, "beta", 0700);
+	make_file(b, "alpha", 0755);
+	mkdir(strcat(strcpy(path, b), "/subdir"), 0755);
+	int fd = open(b, O_RDONLY | O_DIRECTORY);
+	if (symlinkat("beta", fd, "link") == -1
+			|| symlinkat("nowhere", fd, "dangling") == -1
+			|| symlinkat("subdir", fd, "dirlink") == -1) {
+		return EXIT_FAILURE;
+	}
+	close(fd);
+
+	char *original_path = strdup(getenv("PATH"));
+	snprintf(path, sizeof(path), "%s/cache", root);
+	setenv("XDG_CACHE_HOME", path, 1);
+
+	snprintf(path, sizeof(path), "%s::%s/missing:%s", a, root, b);
+	setenv("PATH", path, 1);
+	struct string_vec commands = compgen();
+	tap_is(strcmp(list(&commands), "alpha zed beta link"), 0,
+			"Executables are listed in PATH order, without duplicates");
+	string_vec_destroy(&commands);
+
+	commands = compgen();
+	tap_is(strcmp(list(&commands), "alpha zed beta link"), 0,
+			"Cached listings are the same as scanned ones");
+	string_vec_destroy(&commands);
+
+	make_file(b, "gamma", 0755);
+	unlink(strcat(strcpy(path, a), "/zed"));
+	commands = compgen();
+	tap_is(strcmp(list(&commands), "alpha beta gamma link"), 0,
+			"Changed directories are scanned again");
+	string_vec_destroy(&commands);
+
+	/* A change that leaves the mtime as it was, as with coarse timestamps. */
+	struct stat st;
+	stat(a, &st);
+	make_file(a, "delta", 0755);
+	utimensat(AT_FDCWD, a, (struct timespec[2]){ st.st_atim, st.st_mtim }, 0);
+	commands = compgen();
+	tap_is(strcmp(list(&commands), "alpha delta beta gamma link"), 0,
+			"Directories changed as they're scanned are scanned again");
+	string_vec_destroy(&commands);
+
+	/* Lots of directories, to make sure every one is scanned. */
+	path[0] = '\0';
+	for (size_t i = 0; i < 40; i++) {
+		char dir[256];
+		char name[16];
+		snprintf(dir, sizeof(dir), "%s/dir%zu", root, i);
+		snprintf(name, sizeof(name), "cmd%zu", i);
+		mkdir(dir, 0755);
+		make_file(dir, name, 0755);
+		make_file(dir, "common", 0755);
+		strcat(path, i > 0 ? ":" : "");
+		strcat(path, dir);
+	}
+	setenv("PATH", path, 1);
+	commands = compgen();
+	bool found = commands.count == 41;
+	found &= commands.count > 1 && !strcmp(string_vec_get(&commands, 0), "cmd0");
+	found &= commands.count > 1 && !strcmp(string_vec_get(&commands, 1), "common");
+	for (size_t i = 2; i < commands.count; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "cmd%zu", i - 1);
+		found &= !strcmp(string_vec_get(&commands, i), name);
+	}
+	tap_is(found, true, "Many directories are all scanned in order");
+	string_vec_destroy(&commands);
+
+	setenv("PATH", original_path, 1);
+	free(original_path);
+	char cmd[300];
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	if (system(cmd) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
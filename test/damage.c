@@ -0,0 +1,86 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "damage.h"
+#include "tap.h"
+
+#define WIDTH 64
+#define HEIGHT 48
+#define STRIDE (WIDTH * 4)
+
+static bool rect_is(struct damage_rect rect, int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	return rect.x == x && rect.y == y && rect.width == width && rect.height == height;
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	struct damage damage;
+	damage_clear(&damage);
+	damage_add(&damage, (struct damage_rect){ -4, 40, 100, 20 }, WIDTH, HEIGHT);
+	tap_is(damage.count, 1, "Damage is added");
+	tap_is(rect_is(damage.rects[0], 0, 40, WIDTH, 8), true, "Damage is clipped to the surface");
+
+	damage_add(&damage, (struct damage_rect){ 0, 100, 10, 10 }, WIDTH, HEIGHT);
+	damage_add(&damage, (struct damage_rect){ 5, 5, 0, 10 }, WIDTH, HEIGHT);
+	tap_is(damage.count, 1, "Empty or offscreen damage is ignored");
+
+	damage_add(&damage, (struct damage_rect){ 0, 32, WIDTH, 8 }, WIDTH, HEIGHT);
+	tap_is(damage.count, 1, "Adjacent rows are merged");
+	tap_is(rect_is(damage.rects[0], 0, 32, WIDTH, 16), true, "Merged rows cover both");
+
+	damage_add(&damage, (struct damage_rect){ 10, 36, 4, 4 }, WIDTH, HEIGHT);
+	tap_is(damage.count, 1, "Contained damage is ignored");
+
+	damage_add(&damage, (struct damage_rect){ 0, 0, WIDTH, 8 }, WIDTH, HEIGHT);
+	tap_is(damage.count, 2, "Separate rows are kept apart");
+
+	damage_add(&damage, (struct damage_rect){ 0, 8, WIDTH, 24 }, WIDTH, HEIGHT);
+	tap_is(damage.count, 1, "Filling the gap merges everything");
+	tap_is(rect_is(damage.rects[0], 0, 0, WIDTH, HEIGHT), true, "Merged damage covers the surface");
+
+	/* Scatter more small rectangles than can be kept. */
+	damage_clear(&damage);
+	for (int32_t i = 0; i < 20; i++) {
+		damage_add(&damage, (struct damage_rect){ (i * 7) % 60, (i * 13) % 44, 2, 2 }, WIDTH, HEIGHT);
+	}
+	tap_is(damage.count <= DAMAGE_MAX_RECTS, true, "Damage never grows past the maximum");
+	bool covered = true;
+	for (int32_t i = 0; i < 20; i++) {
+		covered &= damage_covers(&damage, (struct damage_rect){ (i * 7) % 60, (i * 13) % 44, 2, 2 });
+	}
+	tap_is(covered, true, "Folded damage still covers everything");
+
+	damage_add_all(&damage, WIDTH, HEIGHT);
+	tap_is(damage.count, 1, "Damaging everything leaves one rectangle");
+	tap_is(damage_covers(&damage, (struct damage_rect){ 0, 0, WIDTH, HEIGHT }), true, "Damaging everything covers the surface");
+
+	uint8_t *src = malloc(STRIDE * HEIGHT);
+	uint8_t *dst = calloc(STRIDE * HEIGHT, 1);
+	memset(src, 0xff, STRIDE * HEIGHT);
+	damage_clear(&damage);
+	damage_add(&damage, (struct damage_rect){ 0, 4, WIDTH, 2 }, WIDTH, HEIGHT);
+	damage_add(&damage, (struct damage_rect){ 8, 20, 4, 3 }, WIDTH, HEIGHT);
+	damage_copy(&damage, dst, src, STRIDE);
+	size_t copied = 0;
+	for (size_t i = 0; i < STRIDE * HEIGHT; i++) {
+		copied += dst[i] == 0xff;
+	}
+	tap_is(copied, (size_t)(WIDTH * 2 + 4 * 3) * 4, "Only damaged pixels are copied");
+	tap_is(dst[4 * STRIDE], 0xff, "Full rows are copied");
+	tap_is(dst[22 * STRIDE + 11 * 4 + 3], 0xff, "Partial rows are copied");
+	tap_is(dst[22 * STRIDE + 12 * 4], 0, "Nothing past a rectangle is copied");
+	free(src);
+	free(dst);
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
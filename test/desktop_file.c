@@ -0,0 +1,111 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "desktop_file.h"
+#include "desktop_vec.h"
+#include "tap.h"
+
+static bool parse(const char *contents, const char *locale_name, struct desktop_entry *entry)
+{
+	static char buf[4096];
+	snprintf(buf, sizeof(buf), "%s", contents);
+	struct desktop_locale locale = desktop_locale_create(locale_name);
+	*entry = (struct desktop_entry){ 0 };
+	return desktop_file_parse(buf, strlen(buf), &locale, entry);
+}
+
+static bool is(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL) {
+		return a == b;
+	}
+	return !strcmp(a, b);
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	struct desktop_locale locale = desktop_locale_create("sr_RS.UTF-8@latin");
+	tap_is(locale.count == 4
+			&& !strcmp(locale.names[0], "sr_RS@latin")
+			&& !strcmp(locale.names[1], "sr_RS")
+			&& !strcmp(locale.names[2], "sr@latin")
+			&& !strcmp(locale.names[3], "sr"),
+			true,
+			"Locales are matched from most to least specific");
+	locale = desktop_locale_create("C");
+	tap_is(locale.count, 0, "The C locale has no translations");
+	char long_name[80];
+	snprintf(long_name, sizeof(long_name), "de_DE@%070d", 0);
+	locale = desktop_locale_create(long_name);
+	tap_is(locale.count, 0, "Locale names too long to keep aren't cut short");
+
+	const char *file =
+		"# A comment\n"
+		"[Desktop Entry]\n"
+		"Type=Application\n"
+		"Name=Files\n"
+		"Name[de]=Dateien\n"
+		"Name[de_AT]=Dateien (AT)\n"
+		"Name[fr]=Fichiers\n"
+		"GenericName = File Manager\n"
+		"Keywords=folder;manager;\n"
+		"Keywords[de]=Ordner;\n"
+		"Exec=files\\s--new-window %U\n"
+		"Icon=system-file-manager\n"
+		"\n"
+		"[Desktop Action new]\n"
+		"Name=New Window\n"
+		"Exec=files --other\n";
+
+	struct desktop_entry entry;
+	tap_is(parse(file, "C", &entry), true, "Applications are parsed");
+	tap_is(is(entry.name, "Files") && entry.localized_name == NULL,
+			true,
+			"Untranslated names are used without a locale");
+	tap_is(is(entry.generic_name, "File Manager"), true,
+			"Whitespace around = is ignored");
+	tap_is(is(entry.exec, "files --new-window %U"), true,
+			"Escapes are replaced, and other groups ignored");
+	tap_is(is(entry.icon, "system-file-manager") && is(entry.keywords, "folder;manager;"),
+			true,
+			"Icon and keywords are parsed");
+
+	parse(file, "de_DE.UTF-8", &entry);
+	tap_is(is(entry.name, "Files") && is(entry.localized_name, "Dateien")
+			&& is(entry.keywords, "Ordner;"),
+			true,
+			"Translations fall back to the language");
+	parse(file, "de_AT.UTF-8", &entry);
+	tap_is(is(entry.localized_name, "Dateien (AT)"), true,
+			"More specific translations are preferred");
+	parse(file, "ja_JP.UTF-8", &entry);
+	tap_is(entry.localized_name, NULL, "Other translations are ignored");
+
+	tap_is(parse("[Desktop Entry]\r\nType=Application\r\nName=CRLF\r\n", "C", &entry)
+			&& is(entry.name, "CRLF"),
+			true,
+			"CRLF line endings are handled");
+	tap_is(parse("[Desktop Entry]\nType=Application\nName=Gone\nHidden=true\n", "C", &entry),
+			false,
+			"Hidden entries are skipped");
+	tap_is(parse("[Desktop Entry]\nType=Link\nName=Link\nURL=https://example.com\n", "C", &entry),
+			false,
+			"Other types are skipped");
+	tap_is(parse("[Desktop Entry]\nType=Application\nName=Quiet\nNoDisplay=true", "C", &entry)
+			&& entry.no_display,
+			true,
+			"NoDisplay is parsed, without a trailing newline");
+	tap_is(parse("[Other]\nType=Application\nName=Other\n", "C", &entry),
+			false,
+			"Keys outside [Desktop Entry] are ignored");
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
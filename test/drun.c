@@ -0,0 +1,206 @@
+#include <fcntl.h>
+#include <locale.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "desktop_vec.h"
+#include "drun.h"
+#include "tap.h"
+
+static void make_file(const char *dir, const char *name, const char *contents)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL) {
+		abort();
+	}
+	fputs(contents, fp);
+	fclose(fp);
+}
+
+static char *make_dir(const char *root, const char *name)
+{
+	static char path[8][512];
+	static size_t n = 0;
+	char *dir = path[n++ % 8];
+	snprintf(dir, sizeof(path[0]), "%s/%s", root, name);
+	mkdir(dir, 0755);
+	return dir;
+}
+
+/* Set the mtime of dir far enough back for its cache entry to be trusted. */
+static void backdate(const char *dir)
+{
+	struct timespec times[2] = {
+		{ .tv_nsec = UTIME_OMIT },
+		{ .tv_sec = time(NULL) - 3600 }
+	};
+	utimensat(AT_FDCWD, dir, times, 0);
+}
+
+static char *list(const struct desktop_vec *vec)
+{
+	static char buf[1024];
+	buf[0] = '\0';
+	for (size_t i = 0; i < vec->count; i++) {
+		if (i > 0) {
+			strcat(buf, " ");
+		}
+		strcat(buf, vec->buf[i].id);
+		strcat(buf, "=");
+		strcat(buf, desktop_entry_name(&vec->buf[i]));
+		if (vec->buf[i].no_display) {
+			strcat(buf, "!");
+		}
+	}
+	return buf;
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	char root[] = "/tmp/bread-drun-XXXXXX";
+	if (mkdtemp(root) == NULL) {
+		return EXIT_FAILURE;
+	}
+	char path[2048];
+	snprintf(path, sizeof(path), "%s/cache", root);
+	setenv("XDG_CACHE_HOME", path, 1);
+	snprintf(path, sizeof(path), "%s/home", root);
+	setenv("XDG_DATA_HOME", path, 1);
+	snprintf(path, sizeof(path), "%s/system:%s/other", root, root);
+	setenv("XDG_DATA_DIRS", path, 1);
+
+	make_dir(root, "home");
+	make_dir(root, "system");
+	char *home = make_dir(root, "home/applications");
+	char *sys = make_dir(root, "system/applications");
+	char *kde = make_dir(root, "system/applications/kde");
+
+	make_file(home, "editor.desktop",
+			"[Desktop Entry]\nType=Application\nName=My Editor\nExec=vim\n");
+	make_file(home, "browser.desktop",
+			"[Desktop Entry]\nType=Application\nName=Browser\nHidden=true\n");
+	make_file(sys, "editor.desktop",
+			"[Desktop Entry]\nType=Application\nName=Editor\nExec=nano\n");
+	make_file(sys, "browser.desktop",
+			"[Desktop Entry]\nType=Application\nName=Browser\nExec=firefox\n");
+	make_file(sys, "link.desktop",
+			"[Desktop Entry]\nType=Link\nName=Link\n");
+	make_file(sys, "helper.desktop",
+			"[Desktop Entry]\nType=Application\nName=Helper\nNoDisplay=true\n");
+	make_file(sys, "notes.txt", "Not a desktop file\n");
+	make_file(kde, "terminal.desktop",
+			"[Desktop Entry]\nType=Application\nName=Terminal\n"
+			"GenericName=Terminal Emulator\nKeywords=shell;prompt;\n"
+			"Icon=utilities-terminal\nExec=konsole\n");
+
+	backdate(home);
+	backdate(sys);
+	backdate(kde);
+
+	const char *expected = "helper.desktop=Helper! editor.desktop=My Editor "
+		"kde-terminal.desktop=Terminal";
+
+	struct desktop_vec apps = drun_load();
+	tap_is(strcmp(list(&apps), expected), 0,
+			"Desktop files are loaded by id, respecting shadowing");
+	const struct desktop_entry *terminal = &apps.buf[apps.count - 1];
+	tap_is(!strcmp(terminal->generic_name, "Terminal Emulator")
+			&& !strcmp(terminal->keywords, "shell;prompt;")
+			&& !strcmp(terminal->icon, "utilities-terminal")
+			&& !strcmp(terminal->exec, "konsole"),
+			true,
+			"Fields needed for matching and launching are loaded");
+	tap_is(apps.cache.data == NULL, true, "Cold loads parse desktop files");
+	desktop_vec_destroy(&apps);
+
+	apps = drun_load();
+	tap_is(strcmp(list(&apps), expected), 0,
+			"Cached entries are the same as parsed ones");
+	terminal = &apps.buf[apps.count - 1];
+	tap_is(!strcmp(terminal->generic_name, "Terminal Emulator")
+			&& !strcmp(terminal->keywords, "shell;prompt;")
+			&& !strcmp(terminal->icon, "utilities-terminal")
+			&& !strcmp(terminal->exec, "konsole"),
+			true,
+			"Cached entries keep every field");
+	tap_isnt(apps.cache.data, NULL, "Warm loads use the cache");
+	desktop_vec_destroy(&apps);
+
+	make_file(kde, "files.desktop",
+			"[Desktop Entry]\nType=Application\nName=Files\n");
+	apps = drun_load();
+	tap_is(strcmp(list(&apps),
+				"kde-files.desktop=Files helper.desktop=Helper! "
+				"editor.desktop=My Editor kde-terminal.desktop=Terminal"),
+			0,
+			"Changes to subdirectories are noticed");
+	desktop_vec_destroy(&apps);
+
+	char *other = make_dir(root, "other");
+	other = make_dir(root, "other/applications");
+	make_file(other, "clock.desktop",
+			"[Desktop Entry]\nType=Application\nName=Clock\n");
+	apps = drun_load();
+	tap_is(apps.count, 5, "New applications directories are noticed");
+	desktop_vec_destroy(&apps);
+
+	/* A change that leaves the mtime as it was, as with coarse timestamps. */
+	struct stat st;
+	stat(kde, &st);
+	make_file(kde, "clock.desktop",
+			"[Desktop Entry]\nType=Application\nName=Clock\n");
+	utimensat(AT_FDCWD, kde, (struct timespec[2]){ st.st_atim, st.st_mtim }, 0);
+	apps = drun_load();
+	tap_is(apps.count, 6,
+			"Directories changed as they're parsed are parsed again");
+	desktop_vec_destroy(&apps);
+
+	/* Enough files to be parsed in parallel, half of them shadowed. */
+	char name[64];
+	char contents[128];
+	for (size_t i = 0; i < 200; i++) {
+		snprintf(name, sizeof(name), "app%03zu.desktop", i);
+		snprintf(contents, sizeof(contents),
+				"[Desktop Entry]\nType=Application\nName=App %03zu\n", i);
+		make_file(sys, name, contents);
+		if (i % 2 == 0) {
+			snprintf(contents, sizeof(contents),
+					"[Desktop Entry]\nType=Application\nName=Own %03zu\n", i);
+			make_file(home, name, contents);
+		}
+	}
+	apps = drun_load();
+	/* Sorted by name, the 100 "App"s come first, and the "Own"s later. */
+	bool found = apps.count == 206;
+	for (size_t i = 0; found && i < 100; i++) {
+		const struct desktop_entry *app = &apps.buf[i];
+		snprintf(name, sizeof(name), "app%03zu.desktop", 2 * i + 1);
+		snprintf(contents, sizeof(contents), "App %03zu", 2 * i + 1);
+		found &= !strcmp(app->id, name) && !strcmp(desktop_entry_name(app), contents);
+		app = &apps.buf[105 + i];
+		snprintf(name, sizeof(name), "app%03zu.desktop", 2 * i);
+		snprintf(contents, sizeof(contents), "Own %03zu", 2 * i);
+		found &= !strcmp(app->id, name) && !strcmp(desktop_entry_name(app), contents);
+	}
+	tap_is(found, true, "Many desktop files are all parsed and shadowed");
+	desktop_vec_destroy(&apps);
+
+	char cmd[300];
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	if (system(cmd) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fuzzy_match.h"
+#include "tap.h"
+#include "unicode.h"
+
+/*
+ * fuzzy_match() should give exactly the same scores as the recursive matcher
+ * it replaced, which is kept here as a reference. It tries every occurrence
+ * of every pattern character, so is only fit for short strings.
+ */
+
+#undef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static int32_t reference_score(int32_t jump, bool first_char, const char *restrict match)
+{
+	const int adjacency_bonus = 15;
+	const int separator_bonus = 30;
+	const int camel_bonus = 30;
+	const int first_letter_bonus = 15;
+
+	const int leading_letter_penalty = -5;
+	const int max_leading_letter_penalty = -15;
+
+	int32_t score = 0;
+
+	const uint32_t cur = utf8_to_utf32(match);
+
+	if (!first_char && jump == 0) {
+		score += adjacency_bonus;
+	}
+	if (!first_char || jump > 0) {
+		const uint32_t prev = utf8_to_utf32(utf8_prev_char(match));
+		if (utf32_isupper(cur) && utf32_islower(prev)) {
+			score += camel_bonus;
+		}
+		if (utf32_isalnum(cur) && !utf32_isalnum(prev)) {
+			score += separator_bonus;
+		}
+	}
+	if (first_char && jump == 0) {
+		score += first_letter_bonus;
+	}
+
+	if (first_char) {
+		score += MAX(leading_letter_penalty * jump,
+				max_leading_letter_penalty);
+	}
+
+	return score;
+}
+
+static int32_t reference_recurse(
+		const char *restrict pattern,
+		const char *restrict str,
+		int32_t score,
+		bool first_char)
+{
+	if (*pattern == '\0') {
+		return score;
+	}
+
+	const char *match = str;
+	uint32_t search = utf8_to_utf32(pattern);
+
+	int32_t best_score = INT32_MIN;
+
+	while ((match = utf8_strcasechr(match, search)) != NULL) {
+		int32_t jump = 0;
+		for (const char *tmp = str; tmp != match; tmp = utf8_next_char(tmp)) {
+			jump++;
+		}
+		int32_t subscore = reference_recurse(
+				utf8_next_char(pattern),
+				utf8_next_char(match),
+				reference_score(jump, first_char, match),
+				false);
+		best_score = MAX(best_score, subscore);
+		match = utf8_next_char(match);
+	}
+
+	if (best_score == INT32_MIN) {
+		return INT32_MIN;
+	}
+	return score + best_score;
+}
+
+static int32_t reference_match(const char *restrict pattern, const char *restrict str)
+{
+	const int unmatched_letter_penalty = -1;
+	const size_t slen = utf8_strlen(str);
+	const size_t plen = utf8_strlen(pattern);
+	int32_t score = 0;
+
+	if (*pattern == '\0') {
+		return score;
+	}
+	if (slen < plen) {
+		return INT32_MIN;
+	}
+
+	score += unmatched_letter_penalty * (int32_t)(slen - plen);
+	return reference_recurse(pattern, str, score, true);
+}
+
+static uint64_t seed = 0x62726561640a;
+
+static uint32_t next_random(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return (uint32_t)(seed >> 32);
+}
+
+/* Fill buf with up to max_chars characters picked from alphabet. */
+static void make_string(char *buf, const char **alphabet, size_t num_letters, size_t max_chars)
+{
+	const size_t n = next_random() % (max_chars + 1);
+	buf[0] = '\0';
+	for (size_t i = 0; i < n; i++) {
+		strcat(buf, alphabet[next_random() % num_letters]);
+	}
+}
+
+/*
+ * Compare fuzzy_match() with the reference for count generated pairs,
+ * reporting the first that differs.
+ */
+static void is_same_as_reference(
+		const char **alphabet,
+		size_t num_letters,
+		size_t count,
+		const char *message)
+{
+	char pattern[64];
+	char str[256];
+	size_t matches = 0;
+	for (size_t i = 0; i < count; i++) {
+		make_string(pattern, alphabet, num_letters, 4);
+		make_string(str, alphabet, num_letters, 14);
+		const int32_t expected = reference_match(pattern, str);
+		const int32_t score = fuzzy_match(pattern, str);
+		matches += expected != INT32_MIN;
+		if (score != expected) {
+			tap_not_ok("%s: \"%s\" against \"%s\" scored %d, not %d",
+					message, pattern, str, score, expected);
+			return;
+		}
+	}
+	const size_t non_matches = count - matches;
+	if (matches == 0 || non_matches == 0) {
+		tap_not_ok("%s: %zu matches and %zu non-matches generated",
+				message, matches, non_matches);
+		return;
+	}
+	tap_ok("%s", message);
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	static const char *mixed[] = {
+		"a", "b", "c", "A", "B", "x", "_", "-", "/", " ", "1", "é", "Д", "д"
+	};
+	static const char *repeats[] = { "a", "a", "a", "A", "b", "_" };
+	static const char *boundaries[] = { "a", "A", "b", "B", "_", " ", ".", "1" };
+
+	is_same_as_reference(
+			mixed,
+			sizeof(mixed) / sizeof(*mixed),
+			20000,
+			"Same scores as the recursive matcher");
+	is_same_as_reference(
+			repeats,
+			sizeof(repeats) / sizeof(*repeats),
+			20000,
+			"Same scores with repeated characters");
+	is_same_as_reference(
+			boundaries,
+			sizeof(boundaries) / sizeof(*boundaries),
+			20000,
+			"Same scores around word boundaries");
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
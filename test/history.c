@@ -0,0 +1,174 @@
+#include <fcntl.h>
+#include <locale.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "history.h"
+#include "tap.h"
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	char root[] = "/tmp/bread-history-XXXXXX";
+	if (mkdtemp(root) == NULL) {
+		return EXIT_FAILURE;
+	}
+	setenv("XDG_STATE_HOME", root, 1);
+	char *path = history_path("test");
+	char expected[256];
+	snprintf(expected, sizeof(expected), "%s/bread/test", root);
+	tap_is(strcmp(path, expected), 0, "History lives under XDG_STATE_HOME");
+
+	struct history history;
+	tap_is(history_open(&history, path), true, "Missing history files are created");
+	tap_is(history_frecency(&history, "firefox", 7, 0), 0, "Unknown entries have no frecency");
+
+	/* Scores are relative to when the file was created. */
+	const int64_t now = history.header->epoch;
+	const int64_t half_life = HISTORY_HALF_LIFE;
+	history_use(&history, "firefox", 7, now);
+	tap_is(history_frecency(&history, "firefox", 7, now), 1, "Entries are recorded");
+	tap_is(history_frecency(&history, "firefox", 7, now + half_life), 0.5,
+			"Frecency decays");
+	history_use(&history, "firefox", 7, now + half_life);
+	tap_is(history_frecency(&history, "firefox", 7, now + half_life), 1.5,
+			"Later uses count for more");
+	tap_is(history_frecency(&history, "fire", 4, now), 0, "Prefixes don't match");
+
+	char long_a[300];
+	char long_b[300];
+	memset(long_a, 'a', sizeof(long_a));
+	memcpy(long_b, long_a, sizeof(long_b));
+	long_b[sizeof(long_b) - 1] = 'b';
+	history_use(&history, long_a, sizeof(long_a), now);
+	tap_is(history_frecency(&history, long_a, sizeof(long_a), now), 1,
+			"Long entries are recorded");
+	tap_is(history_frecency(&history, long_b, sizeof(long_b), now), 0,
+			"Long entries are told apart past what's stored");
+
+	history_close(&history);
+	history_open(&history, path);
+	tap_is(history_frecency(&history, "firefox", 7, now + half_life), 1.5,
+			"History persists");
+	tap_is(history_weight(&history, "unknown", 7, now), 0, "Unknown entries have no weight");
+	tap_is(history_weight(&history, "firefox", 7, now + half_life)
+			> history_weight(&history, long_a, sizeof(long_a), now + half_life),
+			true,
+			"Frecency adds weight");
+	for (size_t i = 0; i < 100; i++) {
+		history_use(&history, "firefox", 7, now + half_life);
+	}
+	tap_is(history_weight(&history, "firefox", 7, now + half_life), HISTORY_WEIGHT_MAX,
+			"Weight is capped");
+
+	/* Enough entries to need more room. */
+	bool found = true;
+	for (size_t i = 0; i < 1000; i++) {
+		char name[32];
+		int len = snprintf(name, sizeof(name), "entry %zu", i);
+		history_use(&history, name, len, now + half_life);
+	}
+	for (size_t i = 0; i < 1000; i++) {
+		char name[32];
+		int len = snprintf(name, sizeof(name), "entry %zu", i);
+		found &= history_frecency(&history, name, len, now + half_life) == 1;
+	}
+	tap_is(found, true, "History grows as needed");
+	tap_is(history.header->count, 1002, "Every entry is counted");
+	tap_is(history_frecency(&history, "firefox", 7, now + half_life), 101.5,
+			"Growing keeps scores");
+
+	/* Much later, a compaction drops what's decayed away. */
+	history_close(&history);
+	history_open(&history, path);
+	const int64_t later = now + 20 * half_life;
+	for (size_t i = 0; i < 3000; i++) {
+		char name[32];
+		int len = snprintf(name, sizeof(name), "later %zu", i);
+		history_use(&history, name, len, later);
+	}
+	tap_is(history_frecency(&history, "firefox", 7, later), 0,
+			"Old entries are dropped");
+	tap_is(history.header->count, 3000, "Only recent entries are kept");
+	history_close(&history);
+
+	/* Another instance's compaction doesn't lose anything. */
+	int fd;
+	struct history other;
+	history_open(&history, path);
+	history_open(&other, path);
+	for (size_t i = 0; i < 1500; i++) {
+		char name[32];
+		int len = snprintf(name, sizeof(name), "other %zu", i);
+		history_use(&other, name, len, later);
+	}
+	history_use(&history, "firefox", 7, later);
+	tap_is(history_frecency(&history, "other 1499", 10, later), 1,
+			"Files replaced by another instance are mapped afresh");
+	tap_is(history_frecency(&other, "firefox", 7, later), 1,
+			"Uses by another instance are kept");
+	history_close(&other);
+	history_close(&history);
+
+	/* A crash part way through an update can leave the count wrong. */
+	history_open(&history, path);
+	const size_t num_slots = history.header->num_slots;
+	history_close(&history);
+	fd = open(path, O_RDWR);
+	const uint64_t count = 0;
+	if (pwrite(fd, &count, sizeof(count), offsetof(struct history_header, count))
+			!= sizeof(count)) {
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	history_open(&history, path);
+	tap_is(history_frecency(&history, "other 1499", 10, later), 1,
+			"Miscounted history files are kept");
+	history_close(&history);
+
+	/* Even a count that leaves no empty slot can't make lookups go on forever. */
+	fd = open(path, O_RDWR);
+	for (size_t i = 0; i < num_slots; i++) {
+		const uint64_t h = i + 1;
+		const off_t offset = sizeof(struct history_header) + i * sizeof(struct history_record);
+		if (pwrite(fd, &h, sizeof(h), offset) != sizeof(h)) {
+			return EXIT_FAILURE;
+		}
+	}
+	close(fd);
+	history_open(&history, path);
+	tap_is(history_frecency(&history, "firefox", 7, later), 0,
+			"Lookups in a full table give up");
+	history_use(&history, "firefox", 7, later);
+	tap_is(history_frecency(&history, "firefox", 7, later), 1,
+			"Full tables are compacted to make room");
+	history_close(&history);
+
+	/* Anything else in the way is replaced. */
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (fd == -1 || write(fd, "not a history file", 18) != 18) {
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	tap_is(history_open(&history, path), true, "Corrupt history files are replaced");
+	tap_is(history.header->count, 0, "Corrupt history is dropped");
+	history_close(&history);
+
+	free(path);
+	char cmd[300];
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	if (system(cmd) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xkbcommon/xkbcommon.h>
+#include "input.h"
+#include "state.h"
+#include "tap.h"
+
+static void press(struct input_handler *handler, xkb_keysym_t sym, uint32_t c, bool ctrl)
+{
+	struct input input = {
+		.mod_ctrl = ctrl,
+		.symbol = {
+			.xkb_sym = sym,
+			.unicode_char = c
+		}
+	};
+	input_on_keypress(handler, &input);
+}
+
+static void type(struct input_handler *handler, const char *s)
+{
+	for (const char *c = s; *c != '\0'; c++) {
+		press(handler, (xkb_keysym_t)*c, (uint32_t)*c, false);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	struct state state = { 0 };
+	struct input_handler handler = { .state = &state };
+
+	type(&handler, "fire fox");
+	tap_is(strcmp(state.query, "fire fox"), 0, "Typing appends to the query");
+	tap_is(state.query_length, 8, "Query length is kept");
+	tap_is(state.query_dirty, true, "Typing marks the query dirty");
+
+	state.query_dirty = false;
+	press(&handler, XKB_KEY_BackSpace, '\b', false);
+	tap_is(strcmp(state.query, "fire fo"), 0, "Backspace deletes a character");
+	tap_is(state.query_dirty, true, "Deleting marks the query dirty");
+
+	press(&handler, XKB_KEY_w, 'w', true);
+	tap_is(strcmp(state.query, "fire "), 0, "Ctrl-W deletes a word");
+	press(&handler, XKB_KEY_w, 'w', true);
+	tap_is(strcmp(state.query, ""), 0, "Ctrl-W skips trailing spaces");
+
+	press(&handler, 0x0e9, 0x0e9, false);
+	press(&handler, 0x20ac, 0x20ac, false);
+	tap_is(strcmp(state.query, "é€"), 0, "Non-ASCII characters are encoded as UTF-8");
+	press(&handler, XKB_KEY_BackSpace, '\b', false);
+	tap_is(strcmp(state.query, "é"), 0, "Backspace deletes a whole multi-byte character");
+
+	state.query_dirty = false;
+	press(&handler, 0xff0d, '\r', false);
+	press(&handler, XKB_KEY_a, 'a', true);
+	tap_is(state.query_dirty, false, "Other keys leave the query alone");
+
+	press(&handler, XKB_KEY_u, 'u', true);
+	tap_is(state.query_length, 0, "Ctrl-U clears the query");
+	state.query_dirty = false;
+	press(&handler, XKB_KEY_BackSpace, '\b', false);
+	tap_is(state.query_dirty, false, "Backspace on an empty query changes nothing");
+
+	for (size_t i = 0; i < STATE_QUERY_MAX * 2; i++) {
+		press(&handler, 0x20ac, 0x20ac, false);
+	}
+	tap_is(state.query_length < STATE_QUERY_MAX, true, "The query stops growing when full");
+	tap_is(strlen(state.query), state.query_length, "A full query is still terminated");
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
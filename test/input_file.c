@@ -0,0 +1,108 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "candidate.h"
+#include "input_file.h"
+#include "string_set.h"
+#include "tap.h"
+
+/*
+ * Write contents to a temporary file and map it. The mapping outlives the
+ * file itself.
+ */
+static struct input_file open_file(const char *contents, size_t size)
+{
+	char path[] = "/tmp/bread-input-XXXXXX";
+	int fd = mkstemp(path);
+	if (fd == -1 || write(fd, contents, size) != (ssize_t)size) {
+		abort();
+	}
+	close(fd);
+
+	struct input_file file;
+	if (!input_file_open(&file, path)) {
+		abort();
+	}
+	unlink(path);
+	return file;
+}
+
+static bool is_line(const struct candidate_vec *vec, size_t index, const char *line)
+{
+	return index < vec->count
+		&& vec->buf[index].length == strlen(line)
+		&& memcmp(vec->buf[index].string, line, strlen(line)) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	struct candidate_vec vec = candidate_vec_create();
+	const char simple[] = "one\ntwo\n\nFour\n\xff\xfe\nlast";
+	struct input_file file = open_file(simple, sizeof(simple) - 1);
+	tap_is(input_file_read(&file, &vec, NULL), 5, "Lines are read");
+	tap_is(is_line(&vec, 0, "one") && is_line(&vec, 1, "two"), true, "Lines are split");
+	tap_is(is_line(&vec, 2, ""), true, "Empty lines are kept");
+	tap_is(is_line(&vec, 3, "Four"), true, "Lines needing folding are kept");
+	tap_is(is_line(&vec, 4, "last"), true, "Invalid UTF-8 is skipped, unterminated last line isn't");
+	tap_is(vec.buf[0].string, file.data, "Lines aren't copied");
+	candidate_vec_destroy(&vec);
+	input_file_close(&file);
+
+	vec = candidate_vec_create();
+	const char repeats[] = "b\na\nb\n\nab\na\n\nb";
+	file = open_file(repeats, sizeof(repeats) - 1);
+	struct string_set seen = string_set_create();
+	tap_is(input_file_read(&file, &vec, &seen), 4, "Duplicate lines aren't added");
+	tap_is(is_line(&vec, 0, "b") && is_line(&vec, 1, "a")
+			&& is_line(&vec, 2, "") && is_line(&vec, 3, "ab"),
+			true,
+			"First occurrences are kept in order");
+	string_set_destroy(&seen);
+	candidate_vec_destroy(&vec);
+	input_file_close(&file);
+
+	vec = candidate_vec_create();
+	file = open_file("", 0);
+	tap_is(input_file_read(&file, &vec, NULL), 0, "Empty file has no lines");
+	candidate_vec_destroy(&vec);
+	input_file_close(&file);
+
+	/* Lines of every length up to a couple of vector widths, many times over. */
+	const size_t count = 20000;
+	char *contents = malloc(count * 72);
+	size_t size = 0;
+	for (size_t i = 0; i < count; i++) {
+		size_t len = i % 70;
+		for (size_t j = 0; j < len; j++) {
+			contents[size++] = 'a' + (i + j) % 26;
+		}
+		contents[size++] = '\n';
+	}
+	vec = candidate_vec_create();
+	file = open_file(contents, size);
+	tap_is(input_file_read(&file, &vec, NULL), count, "Every line of a long file is read");
+	bool same = true;
+	size_t offset = 0;
+	for (size_t i = 0; i < count && i < vec.count; i++) {
+		size_t len = i % 70;
+		same &= vec.buf[i].length == len
+			&& memcmp(vec.buf[i].string, &contents[offset], len) == 0;
+		offset += len + 1;
+	}
+	tap_is(same, true, "Every line of a long file is correct");
+	candidate_vec_destroy(&vec);
+	input_file_close(&file);
+	free(contents);
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "candidate.h"
+#include "fuzzy_match.h"
+#include "prefilter.h"
+#include "tap.h"
+
+void is_survivor(const char *pattern, const char *str, const char *message)
+{
+	struct candidate_vec vec = candidate_vec_create();
+	struct fuzzy_query query = fuzzy_query_create(pattern);
+	uint32_t survivor;
+	candidate_vec_add(&vec, str, strlen(str));
+	tap_is(prefilter_scan(vec.signatures, vec.count, query.signature, &survivor), 1, message);
+	fuzzy_query_destroy(&query);
+	candidate_vec_destroy(&vec);
+}
+
+void isnt_survivor(const char *pattern, const char *str, const char *message)
+{
+	struct candidate_vec vec = candidate_vec_create();
+	struct fuzzy_query query = fuzzy_query_create(pattern);
+	uint32_t survivor;
+	candidate_vec_add(&vec, str, strlen(str));
+	tap_is(prefilter_scan(vec.signatures, vec.count, query.signature, &survivor), 0, message);
+	fuzzy_query_destroy(&query);
+	candidate_vec_destroy(&vec);
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	is_survivor("fb", "FooBar", "Different case");
+	is_survivor("f b", "foobar", "Spaces in query are ignored");
+	is_survivor("д", "Д", "Multi-byte characters");
+	is_survivor("", "foobar", "Empty query");
+	isnt_survivor("fz", "foobar", "Missing character");
+	isnt_survivor("f0", "foobar", "Missing digit");
+
+	/* Compare against a brute force scan, including odd tail lengths. */
+	const size_t count = 1031;
+	uint64_t *signatures = malloc(count * sizeof(*signatures));
+	uint32_t *survivors = malloc(count * sizeof(*survivors));
+	srand(1);
+	for (size_t i = 0; i < count; i++) {
+		signatures[i] = (uint64_t)rand() << 32 | rand();
+	}
+	const uint64_t signature = 0x0000000300000010;
+	bool same = true;
+	for (size_t n = count - 4; n <= count; n++) {
+		size_t matches = prefilter_scan(signatures, n, signature, survivors);
+		size_t j = 0;
+		for (size_t i = 0; i < n; i++) {
+			if ((signatures[i] & signature) == signature) {
+				same &= j < matches && survivors[j] == i;
+				j++;
+			}
+		}
+		same &= j == matches;
+	}
+	tap_is(same, true, "Vectorised scan agrees with brute force");
+	free(signatures);
+	free(survivors);
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
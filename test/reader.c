@@ -0,0 +1,115 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "reader.h"
+#include "string_set.h"
+#include "string_vec.h"
+#include "tap.h"
+
+static void write_all(int fd, const char *s)
+{
+	size_t len = strlen(s);
+	while (len > 0) {
+		ssize_t n = write(fd, s, len);
+		if (n <= 0) {
+			abort();
+		}
+		s += n;
+		len -= n;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	int fds[2];
+	if (pipe(fds) == -1) {
+		return EXIT_FAILURE;
+	}
+	struct string_vec vec = string_vec_create();
+	struct reader reader = reader_create(fds[0]);
+
+	tap_is(reader_read(&reader, &vec, NULL), 0, "Nothing to read doesn't block");
+	tap_is(reader.eof, false, "Nothing to read isn't the end of input");
+
+	write_all(fds[1], "one\ntwo\nthr");
+	tap_is(reader_read(&reader, &vec, NULL), 2, "Complete lines are added");
+	write_all(fds[1], "ee\n\nfo");
+	tap_is(reader_read(&reader, &vec, NULL), 2, "Lines can span reads");
+	tap_is(strcmp(string_vec_get(&vec, 2), "three"), 0, "Split line is joined");
+	tap_is(strcmp(string_vec_get(&vec, 3), ""), 0, "Empty lines are kept");
+
+	/* Lines longer than the read buffer make it grow. */
+	const size_t long_len = 200000;
+	char *line = malloc(long_len + 1);
+	for (size_t i = 0; i < long_len; i++) {
+		line[i] = 'a' + i % 26;
+	}
+	line[long_len] = '\0';
+	bool same = true;
+	write_all(fds[1], "ur");
+	for (size_t i = 0; i < 4; i++) {
+		write_all(fds[1], "\n");
+		/* A pipe can't hold the whole line, so read as we write. */
+		for (size_t j = 0; j < long_len; j += 4096) {
+			char tmp[4097] = { 0 };
+			memcpy(tmp, &line[j], j + 4096 < long_len ? 4096 : long_len - j);
+			write_all(fds[1], tmp);
+			reader_read(&reader, &vec, NULL);
+		}
+	}
+	write_all(fds[1], "\n\xff\xfe\nlast");
+	close(fds[1]);
+	reader_read(&reader, &vec, NULL);
+	tap_is(reader.eof, true, "Closing the pipe ends the input");
+	tap_is(strcmp(string_vec_get(&vec, 4), "four"), 0, "Line before long lines");
+	for (size_t i = 5; i < 9; i++) {
+		same &= strcmp(string_vec_get(&vec, i), line) == 0;
+	}
+	tap_is(same, true, "Lines longer than a read are joined");
+	tap_is(vec.count, 10, "Invalid UTF-8 is skipped");
+	tap_is(strcmp(string_vec_get(&vec, 9), "last"), 0, "Unterminated last line is added");
+
+	/* Earlier strings shouldn't have moved. */
+	tap_is(strcmp(string_vec_get(&vec, 0), "one"), 0, "First line is intact");
+
+	free(line);
+	string_vec_destroy(&vec);
+	reader_destroy(&reader);
+	close(fds[0]);
+
+	/* Duplicates are dropped, even when split across reads. */
+	if (pipe(fds) == -1) {
+		return EXIT_FAILURE;
+	}
+	vec = string_vec_create();
+	reader = reader_create(fds[0]);
+	struct string_set seen = string_set_create();
+	write_all(fds[1], "b\na\nb\nab");
+	tap_is(reader_read(&reader, &vec, &seen), 2, "Duplicate lines aren't added");
+	write_all(fds[1], "\na\nc\nb");
+	close(fds[1]);
+	tap_is(reader_read(&reader, &vec, &seen), 2, "Duplicates of earlier reads aren't added");
+	tap_is(vec.count == 4
+			&& !strcmp(string_vec_get(&vec, 0), "b")
+			&& !strcmp(string_vec_get(&vec, 1), "a")
+			&& !strcmp(string_vec_get(&vec, 2), "ab")
+			&& !strcmp(string_vec_get(&vec, 3), "c"),
+			true,
+			"First occurrences are kept in order");
+	string_set_destroy(&seen);
+	string_vec_destroy(&vec);
+	reader_destroy(&reader);
+	close(fds[0]);
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
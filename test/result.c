@@ -0,0 +1,234 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "candidate.h"
+#include "result.h"
+#include "tap.h"
+
+static bool same_list(
+		const struct result *a,
+		size_t a_count,
+		const struct result *b,
+		size_t b_count)
+{
+	if (a_count != b_count) {
+		return false;
+	}
+	for (size_t i = 0; i < a_count; i++) {
+		if (a[i].index != b[i].index || a[i].score != b[i].score) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool same_results(const struct result_set *a, const struct result_set *b)
+{
+	return same_list(a->buf, a->count, b->buf, b->count)
+		&& same_list(a->top, a->top_count, b->top, b->top_count);
+}
+
+static int compare_results(const void *a, const void *b)
+{
+	const struct result *ra = a;
+	const struct result *rb = b;
+	if (ra->score != rb->score) {
+		return ra->score > rb->score ? -1 : 1;
+	}
+	return ra->index < rb->index ? -1 : ra->index > rb->index;
+}
+
+static bool in_input_order(const struct result_set *set)
+{
+	for (size_t i = 1; i < set->count; i++) {
+		if (set->buf[i - 1].index >= set->buf[i].index) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Check the best results against a full sort of all of them. */
+static bool is_top(const struct result_set *set, size_t num_results)
+{
+	struct result *sorted = malloc((set->count + 1) * sizeof(*sorted));
+	memcpy(sorted, set->buf, set->count * sizeof(*sorted));
+	qsort(sorted, set->count, sizeof(*sorted), compare_results);
+	size_t count = set->count < num_results ? set->count : num_results;
+	bool same = same_list(set->top, set->top_count, sorted, count);
+	free(sorted);
+	return same;
+}
+
+/*
+ * Type query one character at a time, checking each step against a
+ * from-scratch filter.
+ */
+void is_incremental(
+		const struct candidate_vec *vec,
+		enum matching_algorithm algorithm,
+		const char *query,
+		const char *message)
+{
+	const size_t num_results = 20;
+	struct results results = results_create(vec, algorithm, num_results);
+	char buf[64] = "";
+	bool same = true;
+	bool top = true;
+	for (size_t i = 0; i <= strlen(query); i++) {
+		memcpy(buf, query, i);
+		buf[i] = '\0';
+		struct results fresh = results_create(vec, algorithm, num_results);
+		const struct result_set *set = results_update(&results, buf);
+		same &= same_results(set, results_update(&fresh, buf));
+		same &= in_input_order(set);
+		top &= is_top(set, num_results);
+		results_destroy(&fresh);
+	}
+	tap_is(same, true, message);
+	tap_is(top, true, "Best results match a full sort");
+
+	/* Scrolling past the best results should rank the rest lazily. */
+	const struct result_set *set = results_current(&results);
+	struct result *sorted = malloc((set->count + 1) * sizeof(*sorted));
+	memcpy(sorted, set->buf, set->count * sizeof(*sorted));
+	qsort(sorted, set->count, sizeof(*sorted), compare_results);
+	bool scrolled = results_get(&results, set->count) == NULL;
+	for (size_t i = 0; i < set->count; i++) {
+		const struct result *result = results_get(&results, i);
+		scrolled &= result != NULL
+			&& result->index == sorted[i].index
+			&& result->score == sorted[i].score;
+	}
+	tap_is(scrolled, true, "Scrolling ranks every result");
+	free(sorted);
+
+	/* Backspacing should give back the earlier results. */
+	const struct result_set *shorter = &results.levels[2];
+	buf[2] = '\0';
+	tap_is(results_update(&results, buf), shorter, "Backspace reuses earlier results");
+
+	results_destroy(&results);
+}
+
+/*
+ * Type query while only some of the candidates have been read, then read the
+ * rest in chunks, checking that every level ends up as if they'd all been
+ * there from the start.
+ */
+void is_appended(
+		char (*strings)[24],
+		size_t count,
+		enum matching_algorithm algorithm,
+		const char *query,
+		const char *message)
+{
+	const size_t num_results = 20;
+	struct candidate_vec vec = candidate_vec_create();
+	struct results results = results_create(&vec, algorithm, num_results);
+	size_t read = count / 4;
+	for (size_t i = 0; i < read; i++) {
+		candidate_vec_add(&vec, strings[i], strlen(strings[i]));
+	}
+
+	char buf[64] = "";
+	for (size_t i = 0; i <= strlen(query); i++) {
+		memcpy(buf, query, i);
+		buf[i] = '\0';
+		results_update(&results, buf);
+	}
+	results_get(&results, 2 * num_results);
+
+	while (read < count) {
+		const size_t first = read;
+		read += count / 7 + 1;
+		if (read > count) {
+			read = count;
+		}
+		for (size_t i = first; i < read; i++) {
+			candidate_vec_add(&vec, strings[i], strlen(strings[i]));
+		}
+		results_append(&results, first);
+	}
+
+	bool same = true;
+	for (size_t i = 0; i < results.depth; i++) {
+		struct results fresh = results_create(&vec, algorithm, num_results);
+		const struct result_set *set = &results.levels[i];
+		same &= same_results(set, results_update(&fresh, set->query));
+		results_destroy(&fresh);
+	}
+	tap_is(same, true, message);
+
+	results_destroy(&results);
+	candidate_vec_destroy(&vec);
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	const char *alphabet = "abcAB_/- ";
+	struct candidate_vec vec = candidate_vec_create();
+	const size_t count = 20000;
+	char (*strings)[24] = calloc(count, sizeof(*strings));
+	srand(1);
+	for (size_t i = 0; i < count; i++) {
+		size_t len = rand() % 23;
+		for (size_t j = 0; j < len; j++) {
+			strings[i][j] = alphabet[rand() % strlen(alphabet)];
+		}
+		candidate_vec_add(&vec, strings[i], strlen(strings[i]));
+	}
+
+	is_incremental(&vec, MATCHING_ALGORITHM_SIMPLE, "ab a_", "Simple matching");
+	is_incremental(&vec, MATCHING_ALGORITHM_FUZZY, "ab a_b", "Fuzzy matching");
+
+	is_appended(strings, count, MATCHING_ALGORITHM_SIMPLE, "ab a_", "Simple matching with late candidates");
+	is_appended(strings, count, MATCHING_ALGORITHM_FUZZY, "ab a_b", "Fuzzy matching with late candidates");
+
+	candidate_vec_destroy(&vec);
+
+	/* Weighted candidates, highest weight first, as with history. */
+	vec = candidate_vec_create();
+	for (size_t i = 0; i < count; i++) {
+		candidate_vec_add_weighted(&vec, strings[i], strlen(strings[i]), (count - i) / 1000);
+	}
+	tap_is(vec.by_weight, true, "Candidates added by weight are in order");
+	struct results results = results_create(&vec, MATCHING_ALGORITHM_FUZZY, 20);
+	const struct result_set *set = results_update(&results, "");
+	bool ordered = set->count == count && set->top_count == 20;
+	for (size_t i = 0; ordered && i < set->top_count; i++) {
+		ordered &= set->top[i].index == i
+			&& set->top[i].score == vec.buf[i].weight;
+	}
+	tap_is(ordered, true, "Empty queries rank candidates by weight");
+	tap_is(is_top(set, 20), true, "Empty queries are ranked as if sorted");
+	set = results_update(&results, "ab");
+	tap_is(is_top(set, 20), true, "Weights are added to scores");
+	results_destroy(&results);
+	is_incremental(&vec, MATCHING_ALGORITHM_FUZZY, "ab a_b", "Fuzzy matching with weights");
+	candidate_vec_destroy(&vec);
+
+	vec = candidate_vec_create();
+	candidate_vec_add_weighted(&vec, "firefox", 7, 0);
+	candidate_vec_add_weighted(&vec, "files", 5, 50);
+	tap_is(vec.by_weight, false, "Candidates out of weight order are noticed");
+	results = results_create(&vec, MATCHING_ALGORITHM_FUZZY, 20);
+	set = results_update(&results, "");
+	tap_is(set->top[0].index, 1, "Empty queries still rank by weight out of order");
+	set = results_update(&results, "fi");
+	tap_is(set->top[0].index, 1, "Weights break ties between matches");
+	results_destroy(&results);
+	candidate_vec_destroy(&vec);
+	free(strings);
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
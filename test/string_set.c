@@ -0,0 +1,47 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "string_set.h"
+#include "tap.h"
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	struct string_set set = string_set_create();
+	tap_is(string_set_add(&set, "foo", 3), true, "New string is added");
+	tap_is(string_set_add(&set, "foo", 3), false, "Duplicate isn't added");
+	tap_is(string_set_add(&set, "foobar", 3), false, "Only length bytes are compared");
+	tap_is(string_set_add(&set, "", 0), true, "Empty string is added");
+	tap_is(string_set_add(&set, "", 0), false, "Empty string is only added once");
+
+	/* Enough strings to make the set grow a few times. */
+	const size_t count = 50000;
+	char (*strings)[16] = calloc(count, sizeof(*strings));
+	bool added = true;
+	bool duplicate = true;
+	for (size_t i = 0; i < count; i++) {
+		snprintf(strings[i], sizeof(strings[i]), "string %zu", i);
+		added &= string_set_add(&set, strings[i], strlen(strings[i]));
+	}
+	for (size_t i = 0; i < count; i++) {
+		char str[16];
+		snprintf(str, sizeof(str), "string %zu", i);
+		duplicate &= !string_set_add(&set, str, strlen(str));
+	}
+	tap_is(added, true, "Distinct strings are all added");
+	tap_is(duplicate, true, "Duplicates are found after growing");
+	tap_is(set.count, count + 2, "Every string is counted");
+
+	string_set_destroy(&set);
+	free(strings);
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "string_vec.h"
+#include "tap.h"
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	struct string_vec vec = string_vec_create();
+
+	tap_is(string_vec_add(&vec, "hello world", 5, 0), 0, "First index is 0");
+	tap_is(strcmp(string_vec_get(&vec, 0), "hello"), 0, "Strings are terminated at length");
+	tap_is(string_vec_add(&vec, "", 0, 3), 1, "Indices count up");
+	tap_is(vec.entries[1].flags, 3, "Flags are kept");
+
+	/* Fill several blocks, including with strings bigger than a block. */
+	const size_t count = 100000;
+	const size_t big = 3 << 20;
+	char *buf = malloc(big + 1);
+	memset(buf, 'x', big);
+	buf[big] = '\0';
+	const char *first = string_vec_get(&vec, 0);
+	for (size_t i = 0; i < count; i++) {
+		char str[32];
+		int len = snprintf(str, sizeof(str), "string %zu", i);
+		string_vec_add(&vec, str, len, i);
+		if (i % 25000 == 0) {
+			string_vec_add(&vec, buf, big, 0);
+		}
+	}
+	bool same = true;
+	size_t index = 2;
+	for (size_t i = 0; i < count; i++) {
+		char str[32];
+		snprintf(str, sizeof(str), "string %zu", i);
+		same &= strcmp(string_vec_get(&vec, index), str) == 0;
+		same &= vec.entries[index].length == strlen(str);
+		same &= vec.entries[index].flags == i;
+		index++;
+		if (i % 25000 == 0) {
+			same &= strcmp(string_vec_get(&vec, index), buf) == 0;
+			index++;
+		}
+	}
+	tap_is(same, true, "Strings survive new blocks");
+	tap_is(string_vec_get(&vec, 0), first, "Strings aren't moved");
+	tap_is(vec.count, index, "Every string is counted");
+
+	string_vec_add(&vec, "popped", 6, 0);
+	string_vec_pop(&vec);
+	tap_is(vec.count, index, "Popping removes the last string");
+	string_vec_add(&vec, "pushed", 6, 0);
+	tap_is(strcmp(string_vec_get(&vec, index), "pushed"), 0, "Popped space is reused");
+	tap_is(strcmp(string_vec_get(&vec, index - 1), "string 99999"), 0,
+			"Popping leaves earlier strings alone");
+
+	free(buf);
+	string_vec_destroy(&vec);
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#include <glib.h>
+#include <locale.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tap.h"
+#include "unicode.h"
+
+/*
+ * The generated tables should give exactly the same answers as the glib
+ * functions they replace, for every code point.
+ */
+
+static bool is_surrogate(uint32_t c)
+{
+	return c >= 0xD800 && c <= 0xDFFF;
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	tap_version(14);
+
+	uint32_t bad_class = 0;
+	uint32_t bad_case = 0;
+	uint32_t bad_fold = 0;
+	for (uint32_t c = 0; c <= UNICODE_MAX; c++) {
+		bool same = true;
+		same &= !utf32_isprint(c) == !g_unichar_isprint(c);
+		same &= !utf32_isspace(c) == !g_unichar_isspace(c);
+		same &= !utf32_isupper(c) == !g_unichar_isupper(c);
+		same &= !utf32_islower(c) == !g_unichar_islower(c);
+		same &= !utf32_isalnum(c) == !g_unichar_isalnum(c);
+		if (!same && bad_class == 0) {
+			bad_class = c;
+		}
+
+		if ((utf32_tolower(c) != g_unichar_tolower(c)
+				|| utf32_toupper(c) != g_unichar_toupper(c))
+				&& bad_case == 0) {
+			bad_case = c;
+		}
+
+		if (c == 0 || is_surrogate(c) || bad_fold != 0) {
+			continue;
+		}
+		char buf[8];
+		char expected[8];
+		const int n = g_unichar_to_utf8(c, buf);
+		expected[g_unichar_to_utf8(g_unichar_tolower(c), expected)] = '\0';
+		char *folded = utf8_fold(buf, n, NULL);
+		if (strcmp(folded, expected) != 0) {
+			bad_fold = c;
+		}
+		free(folded);
+	}
+	tap_is(bad_class, 0, "Character classes match glib");
+	tap_is(bad_case, 0, "Case mappings match glib");
+	tap_is(bad_fold, 0, "Folding lowercases as glib does");
+
+	char buf[8];
+	tap_is(utf32_to_utf8(0x20AC, buf), 3, "Encoding gives the length");
+	tap_is(memcmp(buf, "€", 3), 0, "Encoding matches");
+
+	const char *str = "İSTANBUL!";
+	uint32_t *map;
+	char *folded = utf8_fold(str, strlen(str), &map);
+	tap_is(strcmp(folded, "istanbul!"), 0, "Characters can fold to fewer bytes");
+	tap_isnt(map, NULL, "Offsets are mapped when folding changes length");
+	tap_is(map[0], 0, "Folded characters map to the original");
+	tap_is(map[1], 2, "Offsets after the change are mapped");
+	tap_is(map[9], 10, "The end maps to the end of the original");
+	free(folded);
+	free(map);
+
+	folded = utf8_fold("Дж", strlen("Дж"), &map);
+	tap_is(strcmp(folded, "дж"), 0, "Non-ASCII characters are folded");
+	tap_is(map, NULL, "Offsets aren't mapped when nothing moves");
+	free(folded);
+
+	tap_plan();
+
+	return EXIT_SUCCESS;
+}
@@ -1,8 +1,10 @@
 #include <assert.h>
 #include <locale.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "candidate.h"
 #include "fuzzy_match.h"
 #include "tap.h"
 
@@ -42,6 +44,65 @@ void isnt_match(const char *pattern, const char *str, const char *message)
 	isnt_fuzzy_match(pattern, str, message);
 }
 
+void is_folded_match(const char *pattern, const char *str, const char *message)
+{
+	struct candidate_vec vec = candidate_vec_create();
+	candidate_vec_add(&vec, str, strlen(str));
+	const struct candidate *candidate = &vec.buf[0];
+	struct fuzzy_query query = fuzzy_query_create(pattern);
+	tap_isnt(fuzzy_match_query_simple_words(&query, candidate), INT32_MIN, message);
+	tap_isnt(fuzzy_match_query_words(&query, candidate), INT32_MIN, message);
+	fuzzy_query_destroy(&query);
+	candidate_vec_destroy(&vec);
+}
+
+/*
+ * Prepared queries and candidates should behave exactly like the unprepared
+ * matchers, scores and all.
+ */
+void is_same_as_string(const char *pattern, const char *str, const char *message)
+{
+	struct candidate_vec vec = candidate_vec_create();
+	candidate_vec_add(&vec, str, strlen(str));
+	const struct candidate *candidate = &vec.buf[0];
+	struct fuzzy_query query = fuzzy_query_create(pattern);
+	tap_is(fuzzy_match_query_simple_words(&query, candidate),
+			fuzzy_match_simple_words(pattern, str), message);
+	tap_is(fuzzy_match_query_words(&query, candidate),
+			fuzzy_match_words(pattern, str), message);
+	fuzzy_query_destroy(&query);
+	candidate_vec_destroy(&vec);
+}
+
+void is_positions(
+		bool fuzzy,
+		const char *pattern,
+		const char *str,
+		const char *expected,
+		const char *message)
+{
+	struct candidate_vec vec = candidate_vec_create();
+	candidate_vec_add(&vec, str, strlen(str));
+	const struct candidate *candidate = &vec.buf[0];
+	struct fuzzy_query query = fuzzy_query_create(pattern);
+	uint32_t *positions = calloc(query.plen + 1, sizeof(*positions));
+	size_t count;
+	if (fuzzy) {
+		count = fuzzy_match_query_positions(&query, candidate, positions);
+	} else {
+		count = fuzzy_match_query_simple_positions(&query, candidate, positions);
+	}
+	char buf[64] = "";
+	for (size_t i = 0; i < count; i++) {
+		snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "%s%u",
+				i > 0 ? " " : "", positions[i]);
+	}
+	tap_is(strcmp(buf, expected), 0, message);
+	free(positions);
+	fuzzy_query_destroy(&query);
+	candidate_vec_destroy(&vec);
+}
+
 int main(int argc, char *argv[])
 {
 	setlocale(LC_ALL, "");
@@ -60,6 +121,106 @@ int main(int argc, char *argv[])
 	tap_todo("Needs composed character comparison");
 	isnt_fuzzy_match("ạ", "aọ", "Decomposed diacritics, character mismatch");
 
+	/* Long strings still get the best match, not just the first. */
+	char first[128];
+	char other[128];
+	memset(first, 'x', sizeof(first));
+	memcpy(first + sizeof(first) - 4, "_ab", 4);
+	first[0] = 'a';
+	memcpy(other, first, sizeof(other));
+	other[0] = 'c';
+	tap_is(fuzzy_match("ab", first), fuzzy_match("ab", other),
+			"Best match found in string longer than 100 characters");
+
+	/* Prepared candidates. */
+	is_folded_match("д", "Д", "Folded candidate, different case");
+	is_same_as_string("o", "\u1ECD", "Folded candidate, composed diacritic");
+	is_same_as_string("o", "o\u0323", "Folded candidate, decomposed diacritic");
+	is_same_as_string("\u1ECD", "xo\u0323", "Folded candidate, composed pattern");
+	is_same_as_string("o\u0323", "\u1ECD", "Folded candidate, mixed composition");
+	is_same_as_string("\u1EA1", "a\u1ECD", "Folded candidate, diacritic mismatch");
+	is_same_as_string("ca", "Ca\u0301fe\u0301 A\u0323", "Folded candidate, decomposed accents");
+	is_same_as_string("cf", "C\u00C1F\u00C9", "Folded candidate, composed accents");
+	is_same_as_string("a\u0323 o", "\u1EA0 xo\u0323", "Folded candidate, several accented words");
+	is_same_as_string("istanbul", "\u0130stanbul", "Folded candidate, dotted capital I");
+	is_same_as_string("i\u0307", "\u0130", "Folded candidate, dotted capital I, full folding");
+	is_same_as_string("strasse", "Stra\u00DFe", "Folded candidate, sharp s, full folding");
+	is_same_as_string("stra\u00DFe", "STRASSE", "Folded candidate, sharp s against ss");
+	is_same_as_string("s", "\u017F", "Folded candidate, long s");
+	is_same_as_string("\u03C3", "\u03C2", "Folded candidate, final sigma");
+	is_same_as_string("\u03C2", "\u03A3", "Folded candidate, final sigma against capital");
+	{
+		const char *str = "\u1ECDx";
+		struct candidate_vec vec = candidate_vec_create();
+		candidate_vec_add(&vec, str, strlen(str));
+		const struct candidate *candidate = &vec.buf[0];
+		struct fuzzy_query query = fuzzy_query_create("x");
+		tap_is(fuzzy_match_query_simple_words(&query, candidate), -3,
+				"Folded candidate, offset of match in original string");
+		fuzzy_query_destroy(&query);
+		candidate_vec_destroy(&vec);
+	}
+
+	{
+		/* Candidates needn't be nul-terminated. */
+		struct candidate_vec vec = candidate_vec_create();
+		candidate_vec_add(&vec, "FooBar baz", 6);
+		const struct candidate *candidate = &vec.buf[0];
+		struct fuzzy_query query = fuzzy_query_create("fb");
+		tap_isnt(fuzzy_match_query_words(&query, candidate), INT32_MIN,
+				"Candidate from part of a string");
+		fuzzy_query_destroy(&query);
+		query = fuzzy_query_create("z");
+		tap_is(fuzzy_match_query_words(&query, candidate), INT32_MIN,
+				"Candidate ends at its length");
+		tap_is(fuzzy_match_query_simple_words(&query, candidate), INT32_MIN,
+				"Simple match ends at candidate length");
+		fuzzy_query_destroy(&query);
+		candidate_vec_destroy(&vec);
+	}
+
+	{
+		/* Already folded candidates aren't copied, so end at their length. */
+		const char *str = "foobar zap";
+		struct candidate_vec vec = candidate_vec_create();
+		candidate_vec_add(&vec, str, 6);
+		const struct candidate *candidate = &vec.buf[0];
+		tap_is(candidate->folded == str && candidate->folded_length == 6, true,
+				"Already folded candidate shares its string");
+		struct fuzzy_query query = fuzzy_query_create("z");
+		tap_is(fuzzy_match_query_words(&query, candidate), INT32_MIN,
+				"Shared folded string ends at candidate length");
+		tap_is(fuzzy_match_query_simple_words(&query, candidate), INT32_MIN,
+				"Simple match ends at shared folded string length");
+		fuzzy_query_destroy(&query);
+		candidate_vec_destroy(&vec);
+	}
+
+	{
+		/* Enough folded strings and maps to fill several blocks. */
+		const char *str = "\u0130stanbul \u00C7ay";
+		struct candidate_vec vec = candidate_vec_create();
+		for (size_t i = 0; i < 100000; i++) {
+			candidate_vec_add(&vec, str, strlen(str));
+		}
+		bool same = vec.num_blocks > 1;
+		for (size_t i = 0; i < vec.count; i++) {
+			same &= vec.buf[i].folded_length == vec.buf[0].folded_length
+				&& !memcmp(vec.buf[i].folded, vec.buf[0].folded, vec.buf[0].folded_length)
+				&& vec.buf[i].map[vec.buf[i].folded_length] == strlen(str);
+		}
+		tap_is(same, true, "Candidates spanning several blocks");
+		candidate_vec_destroy(&vec);
+	}
+
+	/* Match positions for highlighting. */
+	is_positions(true, "fb", "FooBar", "0 3", "Fuzzy positions");
+	is_positions(true, "ab", "axb_ab", "4 5", "Fuzzy positions of best match");
+	is_positions(true, "ba fo", "FooBar", "0 1 3 4", "Fuzzy positions of several words");
+	is_positions(false, "oba", "FooBar", "2 3 4", "Simple positions");
+	is_positions(false, "x", "\u1ECDx", "3", "Positions in original string");
+	is_positions(true, "fz", "FooBar", "", "No positions without a match");
+
 	tap_plan();
 
 	return EXIT_SUCCESS;
@@ -0,0 +1,105 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unicode_tables.h"
+
+/*
+ * Generate the lookup tables declared in unicode_tables.h.
+ *
+ * glib is used as the source of truth, so that the tables give exactly the
+ * same answers as the g_unichar_* functions they replace.
+ */
+
+static int32_t property_class(uint32_t c)
+{
+  int32_t class = 0;
+  class |= g_unichar_isprint(c) ? UNICODE_CLASS_PRINT : 0;
+  class |= g_unichar_isspace(c) ? UNICODE_CLASS_SPACE : 0;
+  class |= g_unichar_isupper(c) ? UNICODE_CLASS_UPPER : 0;
+  class |= g_unichar_islower(c) ? UNICODE_CLASS_LOWER : 0;
+  class |= g_unichar_isalnum(c) ? UNICODE_CLASS_ALNUM : 0;
+  return class;
+}
+
+static int32_t property_lower(uint32_t c)
+{
+  return (int32_t)g_unichar_tolower(c) - (int32_t)c;
+}
+
+static int32_t property_upper(uint32_t c)
+{
+  return (int32_t)g_unichar_toupper(c) - (int32_t)c;
+}
+
+static void write_table(
+    FILE *out,
+    const char *name,
+    const char *type,
+    int32_t (*property)(uint32_t))
+{
+  int32_t *blocks = malloc(UNICODE_NUM_BLOCKS * UNICODE_BLOCK_SIZE * sizeof(*blocks));
+  uint32_t index[UNICODE_NUM_BLOCKS];
+  size_t num_blocks = 0;
+
+  for (size_t b = 0; b < UNICODE_NUM_BLOCKS; b++) {
+    int32_t *block = &blocks[num_blocks * UNICODE_BLOCK_SIZE];
+    for (size_t i = 0; i < UNICODE_BLOCK_SIZE; i++) {
+      block[i] = property((b << UNICODE_BLOCK_SHIFT) | i);
+    }
+    size_t match = 0;
+    while (match < num_blocks
+        && memcmp(
+          &blocks[match * UNICODE_BLOCK_SIZE],
+          block,
+          UNICODE_BLOCK_SIZE * sizeof(*block))) {
+      match++;
+    }
+    index[b] = match * UNICODE_BLOCK_SIZE;
+    if (match == num_blocks) {
+      num_blocks++;
+    }
+  }
+
+  fprintf(out, "const uint32_t unicode_%s_index[UNICODE_NUM_BLOCKS] = {", name);
+  for (size_t b = 0; b < UNICODE_NUM_BLOCKS; b++) {
+    fprintf(out, "%s%u,", b % 8 ? " " : "\n\t", index[b]);
+  }
+  fprintf(out, "\n};\n\n");
+
+  fprintf(out, "const %s unicode_%s_blocks[%zu] = {", type, name, num_blocks * UNICODE_BLOCK_SIZE);
+  for (size_t i = 0; i < num_blocks * UNICODE_BLOCK_SIZE; i++) {
+    fprintf(out, "%s%d,", i % 8 ? " " : "\n\t", blocks[i]);
+  }
+  fprintf(out, "\n};\n\n");
+
+  free(blocks);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s OUTPUT\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  FILE *out = fopen(argv[1], "w");
+  if (out == NULL) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  fprintf(out, "/* Generated by gen_unicode_tables, do not edit. */\n\n");
+  fprintf(out, "#include <stdint.h>\n");
+  fprintf(out, "#include \"unicode_tables.h\"\n\n");
+  write_table(out, "class", "uint8_t", property_class);
+  write_table(out, "lower", "int32_t", property_lower);
+  write_table(out, "upper", "int32_t", property_upper);
+
+  if (fclose(out) != 0) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}